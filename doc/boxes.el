@@ -83,6 +83,10 @@
   "Arguments to the boxes command.")
 (make-variable-buffer-local 'boxes-args)
 ;;;###autoload
+(defvar boxes-server nil
+  "Socket of a boxes server started with `boxes -w', or nil.
+If set, boxes has the server do the work, which is faster.")
+;;;###autoload
 (defun boxes-create ()
   "Automagicly create a new box around the region based on the default type."
   (interactive "*")
@@ -117,7 +121,12 @@ To remove a box simply prefix a 1 to the callL M-1 M-x boxes-command-on-region w
 		     (concat boxes-args " -r "))
 		 (if type
 		     (concat boxes-args " -d " type)))))
-    (shell-command-on-region start end command-string nil 1)))
+    (let ((process-environment
+	   (if boxes-server
+	       (cons (concat "BOXES_SERVER=" (expand-file-name boxes-server))
+		     process-environment)
+	     process-environment)))
+      (shell-command-on-region start end command-string nil 1))))
 
 (provide 'boxes)
 ;;; boxes.el ends here
@@ -0,0 +1,660 @@
+/*
+ *  File:             batch.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 13:56h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Batch mode, processing of many files in parallel
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "batch.h"
+
+
+
+/*
+ *  Every worker thread owns a queue of tasks (indexes into the list of
+ *  files). Initially, the files are distributed evenly among the queues.
+ *  A worker takes its tasks from the head of its own queue. When its queue
+ *  is empty, it steals tasks from the tail of the other queues, so all
+ *  workers are kept busy even if some files take much longer than others.
+ */
+typedef struct {
+    size_t head;                         /* next task of the owner */
+    size_t tail;                         /* one past the last task */
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+} taskqueue_t;
+
+typedef struct {
+    int    id;                           /* index of the worker's own queue */
+    int    failed;                       /* number of files not processed */
+#ifdef HAVE_PTHREAD
+    pthread_t thread;
+#endif
+} worker_t;
+
+
+static char       **files = NULL;        /* input files, manifests expanded */
+static size_t       anz_files = 0;       /* number of entries in files */
+static taskqueue_t *queues = NULL;       /* one task queue per worker */
+static int          anz_workers = 0;     /* number of worker threads */
+
+static const opt_t *master_opt = NULL;   /* options of the main thread */
+static design_t    *master_designs = NULL;  /* designs of the main thread */
+static int          master_anz_designs = 0;  /* number of master_designs */
+static int        (*process_file)() = NULL; /* does the work on opt.infile */
+
+
+
+static int add_file (char *path)
+/*
+ *  Append the given path to the list of files to process.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char **tmp;
+
+    if ((anz_files & (anz_files - 1)) == 0) {     /* 0, 1, 2, 4, 8, ... */
+        tmp = (char **) realloc (files, (anz_files? 2*anz_files: 1)
+                * sizeof(char *));
+        if (tmp == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        files = tmp;
+    }
+    files[anz_files++] = path;
+    return 0;
+}
+
+
+
+static int read_manifest (const char *name)
+/*
+ *  Add the files listed in a manifest to the list of files to process.
+ *  The manifest contains one path per line. Empty lines are ignored.
+ *
+ *    name   path of the manifest, "-" for standard input
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    FILE   *f;
+    char    buf[LINE_MAX+2];
+    char   *path;
+    size_t  len;
+    int     rc = 0;
+
+    if (strcmp (name, "-") == 0)
+        f = stdin;
+    else
+        f = fopen (name, "r");
+    if (f == NULL) {
+        fprintf (stderr, "%s: Can\'t open manifest file -- %s\n", PROJECT, name);
+        return 1;
+    }
+
+    while (rc == 0 && fgets (buf, LINE_MAX+1, f)) {
+        len = strcspn (buf, "\r\n");
+        if (len == 0)
+            continue;
+        buf[len] = '\0';
+        path = (char *) strdup (buf);
+        if (path == NULL) {
+            perror (PROJECT);
+            rc = 1;
+        }
+        else {
+            rc = add_file (path);
+        }
+    }
+    if (rc == 0 && ferror (f)) {
+        perror (PROJECT);
+        rc = 1;
+    }
+
+    if (f != stdin)
+        fclose (f);
+    return rc;
+}
+
+
+
+static int next_task (const int self, size_t *task)
+/*
+ *  Get the next file to process for the given worker, stealing work from
+ *  other workers if necessary.
+ *
+ *    self   index of the worker
+ *    task   RESULT: index of the file to process
+ *
+ *  RETURNS:  != 0   a task was found
+ *            == 0   all work is done
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    taskqueue_t *q;
+    int          k;
+    int          found = 0;
+
+    for (k=0; k<anz_workers && !found; ++k) {
+        q = queues + (self + k) % anz_workers;
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_lock (&(q->lock));
+    #endif
+        if (q->head < q->tail) {
+            if (k == 0)
+                *task = q->head++;       /* own queue */
+            else
+                *task = --q->tail;       /* steal */
+            found = 1;
+        }
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_unlock (&(q->lock));
+    #endif
+    }
+
+    return found;
+}
+
+
+
+static reprule_t *copy_rules (const reprule_t *rules, const size_t anz_rules)
+/*
+ *  Make a private copy of the given rules for use by the current thread.
+ *  The strings are shared, but the compiled regular expressions are not,
+ *  because regexec() stores its results in them.
+ *
+ *  RETURNS:  != NULL   success, the copy
+ *            == NULL   no rules, or out of memory
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    reprule_t *res;
+    size_t     j;
+
+    if (rules == NULL || anz_rules == 0)
+        return NULL;
+    res = (reprule_t *) malloc (anz_rules * sizeof(reprule_t));
+    if (res == NULL) {
+        perror (PROJECT);
+        return NULL;
+    }
+    memcpy (res, rules, anz_rules * sizeof(reprule_t));
+    for (j=0; j<anz_rules; ++j)
+        res[j].prog = NULL;
+    return res;
+}
+
+
+
+static void free_rules (reprule_t *rules, const size_t anz_rules)
+{
+    size_t j;
+
+    if (rules == NULL)
+        return;
+    for (j=0; j<anz_rules; ++j)
+        BFREE (rules[j].prog);
+    BFREE (rules);
+}
+
+
+
+void free_design_copy (design_t *adesigns, const int anz)
+/*
+ *  Free a copy of designs made by copy_designs().
+ *
+ *    anz   number of designs which have been copied
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    if (adesigns == NULL)
+        return;
+    for (i=0; i<anz; ++i) {
+        free_rules (adesigns[i].reprules, adesigns[i].anz_reprules);
+        free_rules (adesigns[i].revrules, adesigns[i].anz_revrules);
+    }
+    BFREE (adesigns);
+}
+
+
+
+static void free_all_rules (reprule_t *rules, const size_t anz_rules)
+{
+    size_t j;
+
+    if (rules == NULL)
+        return;
+    for (j=0; j<anz_rules; ++j) {
+        BFREE (rules[j].search);
+        BFREE (rules[j].repstr);
+        BFREE (rules[j].prog);
+    }
+    BFREE (rules);
+}
+
+
+
+void free_designs (design_t *adesigns, const int anz)
+/*
+ *  Free the given designs, including all shapes, strings, and rules.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    design_t *d;
+    int       i;
+    int       j;
+
+    if (adesigns == NULL)
+        return;
+    for (i=0, d=adesigns; i<anz; ++i, ++d) {
+        BFREE (d->name);
+        if (d->info) {
+            BFREE (d->info->author);
+            BFREE (d->info->designer);
+            BFREE (d->info->created);
+            BFREE (d->info->revision);
+            BFREE (d->info->revdate);
+            BFREE (d->info->sample);
+            BFREE (d->info);
+        }
+        for (j=0; j<ANZ_SHAPES; ++j)
+            freeshape (d->shape + j);
+        free_all_rules (d->reprules, d->anz_reprules);
+        free_all_rules (d->revrules, d->anz_revrules);
+        BFREE (d->west_trims);
+        BFREE (d->east_trims);
+        BFREE (d->corner_trims);
+    }
+    BFREE (adesigns);
+}
+
+
+
+design_t *copy_designs (const design_t *src, const int anz)
+/*
+ *  Make a private copy of the given designs for use by the current thread.
+ *  The shapes and strings are shared, as they are not modified while
+ *  processing input, but the rules are copied (see copy_rules()).
+ *
+ *  RETURNS:  != NULL   success, the copy
+ *            == NULL   error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    design_t *res;
+    design_t *d;
+    int       i;
+
+    res = (design_t *) malloc (anz * sizeof(design_t));
+    if (res == NULL) {
+        perror (PROJECT);
+        return NULL;
+    }
+    memcpy (res, src, anz * sizeof(design_t));
+
+    for (i=0, d=res; i<anz; ++i, ++d) {
+        d->current_rule = NULL;
+        d->reprules = copy_rules (src[i].reprules, d->anz_reprules);
+        d->revrules = copy_rules (src[i].revrules, d->anz_revrules);
+        if ((d->reprules == NULL && d->anz_reprules > 0)
+                || (d->revrules == NULL && d->anz_revrules > 0))
+        {
+            free_design_copy (res, i + 1);
+            return NULL;
+        }
+    }
+    return res;
+}
+
+
+
+static void cleanup_thread()
+/*
+ *  Free the thread-local state of a worker thread.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    free_design_copy (designs, anz_designs);
+    designs = NULL;
+    if (opt.stack != master_opt->stack)
+        BFREE (opt.stack);
+    BFREE (input.lines);                 /* line array kept by process_file */
+    input.alloc_lines = 0;
+}
+
+
+
+static int setup_thread()
+/*
+ *  Initialize the thread-local state of a worker thread from that of the
+ *  main thread. The designs are copied, see copy_designs().
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    opt = *master_opt;
+    anz_designs = master_anz_designs;
+    designs = copy_designs (master_designs, anz_designs);
+    if (designs == NULL)
+        return 1;
+    opt.design = designs + (master_opt->design - master_designs);
+    if (master_opt->target)
+        opt.target = designs + (master_opt->target - master_designs);
+    if (master_opt->anz_stack > 0) {
+        opt.stack = (design_t **) malloc (opt.anz_stack * sizeof(design_t *));
+        if (opt.stack == NULL) {
+            perror (PROJECT);
+            cleanup_thread();
+            return 1;
+        }
+        for (i=0; i<opt.anz_stack; ++i)
+            opt.stack[i] = designs + (master_opt->stack[i] - master_designs);
+    }
+
+    return 0;
+}
+
+
+
+static int make_parent_dirs (char *path)
+/*
+ *  Create the directories leading up to the given file, if they do not
+ *  exist yet.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *p;
+    int   rc;
+
+    for (p=strchr(path+1, '/'); p; p=strchr(p+1, '/')) {
+        *p = '\0';
+    #ifdef _WIN32
+        rc = mkdir (path);
+    #else
+        rc = mkdir (path, 0777);
+    #endif
+        *p = '/';
+        if (rc && errno != EEXIST) {
+            fprintf (stderr, "%s: Can\'t create directory for -- %s\n",
+                    PROJECT, path);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+static int process_one (const char *path)
+/*
+ *  Process a single input file. The result is written to a temporary file
+ *  first, which replaces the output file only if all went well. The output
+ *  file is the input file itself, or its counterpart in the output
+ *  directory (-o).
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const char *rel = path;              /* path relative to output dir */
+    char       *outpath;                 /* final output file */
+    char       *tmppath;                 /* temporary output file */
+    struct stat st;
+    int         fd;
+    int         rc;
+
+    opt.infile = fopen (path, "r");
+    if (opt.infile == NULL) {
+        fprintf (stderr, "%s: Can\'t open input file -- %s\n", PROJECT, path);
+        return 1;
+    }
+
+    if (opt.outdir) {
+        while (*rel == '/')
+            ++rel;
+        while (rel[0] == '.' && rel[1] == '/')
+            rel += 2;
+        outpath = (char *) malloc (strlen (opt.outdir) + strlen (rel) + 2);
+        if (outpath)
+            sprintf (outpath, "%s/%s", opt.outdir, rel);
+    }
+    else {
+        outpath = (char *) strdup (path);
+    }
+    tmppath = outpath? (char *) malloc (strlen (outpath) + 14): NULL;
+    if (tmppath == NULL) {
+        perror (PROJECT);
+        fclose (opt.infile);
+        BFREE (outpath);
+        return 1;
+    }
+    sprintf (tmppath, "%s.boxes-XXXXXX", outpath);
+
+    if (opt.outdir && make_parent_dirs (tmppath)) {
+        fclose (opt.infile);
+        BFREE (tmppath);
+        BFREE (outpath);
+        return 1;
+    }
+    fd = mkstemp (tmppath);
+    opt.outfile = fd < 0? NULL: fdopen (fd, "w");
+    if (opt.outfile == NULL) {
+        fprintf (stderr, "%s: Can\'t create output file for -- %s\n",
+                PROJECT, path);
+        if (fd >= 0) {
+            close (fd);
+            unlink (tmppath);
+        }
+        fclose (opt.infile);
+        BFREE (tmppath);
+        BFREE (outpath);
+        return 1;
+    }
+
+    rc = (*process_file)();
+
+    /*
+     *  The result keeps the permissions of the input file.
+     */
+    if (rc == 0 && fstat (fileno (opt.infile), &st) == 0)
+        fchmod (fd, st.st_mode & 07777);
+    fclose (opt.infile);
+    if (fclose (opt.outfile) != 0 && rc == 0) {
+        perror (PROJECT);
+        rc = 1;
+    }
+    if (rc == 0 && rename (tmppath, outpath) != 0) {
+        perror (PROJECT);
+        rc = 1;
+    }
+    if (rc)
+        unlink (tmppath);
+
+    BFREE (tmppath);
+    BFREE (outpath);
+    return rc;
+}
+
+
+
+static void *worker (void *arg)
+/*
+ *  Main function of a worker thread. Processes files until there are no
+ *  more tasks in any of the queues.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    worker_t *w = (worker_t *) arg;
+    size_t    task;
+
+    if (setup_thread()) {
+        w->failed = 1;
+        return NULL;
+    }
+    while (next_task (w->id, &task)) {
+        if (process_one (files[task])) {
+            fprintf (stderr, "%s: File not processed -- %s\n", PROJECT,
+                    files[task]);
+            ++(w->failed);
+        }
+    }
+    cleanup_thread();
+    return NULL;
+}
+
+
+
+int batch_process (int (*process)())
+/*
+ *  Process all files given on the command line (opt.files) in parallel,
+ *  using opt.jobs worker threads. Command line arguments of the form
+ *  "@file" are manifests listing the files to process.
+ *
+ *    process   function which processes opt.infile and writes the result
+ *              to opt.outfile, using opt.design
+ *
+ *  RETURNS:  == 0   all files processed successfully
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    worker_t *workers;
+    size_t    chunk;
+    int       failed = 0;
+    int       i;
+
+    for (i=0; i<opt.anz_files; ++i) {
+        if (opt.files[i][0] == '@') {
+            if (read_manifest (opt.files[i] + 1))
+                return 1;
+        }
+        else if (add_file (opt.files[i])) {
+            return 1;
+        }
+    }
+    if (anz_files == 0)
+        return 0;
+
+    anz_workers = opt.jobs;
+    #ifndef HAVE_PTHREAD
+        anz_workers = 1;
+    #endif
+    if ((size_t) anz_workers > anz_files)
+        anz_workers = (int) anz_files;
+
+    queues = (taskqueue_t *) calloc (anz_workers, sizeof(taskqueue_t));
+    workers = (worker_t *) calloc (anz_workers, sizeof(worker_t));
+    if (queues == NULL || workers == NULL) {
+        perror (PROJECT);
+        BFREE (queues);
+        BFREE (workers);
+        return 1;
+    }
+
+    chunk = anz_files / anz_workers;
+    for (i=0; i<anz_workers; ++i) {
+        queues[i].head = i * chunk;
+        queues[i].tail = (i == anz_workers-1)? anz_files: (i+1) * chunk;
+        workers[i].id = i;
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_init (&(queues[i].lock), NULL);
+    #endif
+    }
+
+    master_opt = &opt;
+    master_designs = designs;
+    master_anz_designs = anz_designs;
+    process_file = process;
+
+    #ifdef DEBUG
+        fprintf (stderr, "Batch mode: %lu files, %d workers.\n",
+                (unsigned long) anz_files, anz_workers);
+    #endif
+
+    #ifdef HAVE_PTHREAD
+        for (i=0; i<anz_workers; ++i) {
+            if (pthread_create (&(workers[i].thread), NULL, worker, workers + i)) {
+                perror (PROJECT);
+                workers[i].failed = 1;
+                break;
+            }
+        }
+        while (--i >= 0)
+            pthread_join (workers[i].thread, NULL);
+        for (i=0; i<anz_workers; ++i)
+            pthread_mutex_destroy (&(queues[i].lock));
+    #else
+        worker (workers);
+    #endif
+
+    for (i=0; i<anz_workers; ++i)
+        failed += workers[i].failed;
+
+    BFREE (queues);
+    BFREE (workers);
+    return failed? 1: 0;
+}
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
@@ -57,6 +57,12 @@
 #include "regexp.h"
 #include "generate.h"
 #include "remove.h"
+#include "batch.h"
+#include "process.h"
+#include "builtin.h"
+#include "detcache.h"
+#include "server.h"
+#include "shmdesigns.h"
 
 #ifdef __MINGW32__
     #include <windows.h>
@@ -87,16 +93,7 @@ static const char rcsid_boxes_c[] =
 extern int yyparse();
 extern FILE *yyin;                       /* lex input file */
 
-char *yyfilename = NULL;                 /* file name of config file used */
-
-design_t *designs = NULL;                /* available box designs */
-
-int design_idx = 0;                      /* anz_designs-1 */
-int anz_designs = 0;                     /* no of designs after parsing */
-
-opt_t opt;                               /* command line options */
-
-input_t input = INPUT_INITIALIZER;       /* input lines */
+static int use_builtin = 0;              /* true if built-in designs are used */
 
 
 /*       _\|/_
@@ -115,19 +112,30 @@ static void usage (FILE *st)
 {
     fprintf (st, "Usage:  %s [options] [infile [outfile]]\n", PROJECT);
     fprintf (st, "        -a fmt   alignment/positioning of text inside box [default: hlvt]\n");
+    fprintf (st, "        -b rec   box each record separately (l, p, or s<separator>)\n");
     fprintf (st, "        -c str   use single shape box design where str is the W shape\n");
-    fprintf (st, "        -d name  box design [default: first one in file]\n");
+    fprintf (st, "        -d name  box design, or list of designs for nested boxes [default:\n");
+    fprintf (st, "                 first one in file]\n");
+    fprintf (st, "        -e       use the built-in box designs, not a config file\n");
     fprintf (st, "        -f file  configuration file\n");
+    fprintf (st, "        -g       remove all boxes found in the input, not just one\n");
     fprintf (st, "        -h       print usage information\n");
     fprintf (st, "        -i mode  indentation mode [default: box]\n");
+    fprintf (st, "        -j n     batch mode, process all files given using n threads\n");
     fprintf (st, "        -k bool  leading/trailing blank line retention on removal\n");
     fprintf (st, "        -l       list available box designs w/ samples\n");
     fprintf (st, "        -m       mend box, i.e. remove it and redraw it afterwards\n");
+    fprintf (st, "        -o dir   batch mode output directory [default: in place]\n");
     fprintf (st, "        -p fmt   padding [default: none]\n");
+    fprintf (st, "        -q pct   quick autodetection, accept design at pct%% of best score\n");
     fprintf (st, "        -r       remove box\n");
     fprintf (st, "        -s wxh   box size (width w and/or height h)\n");
     fprintf (st, "        -t str   tab stop distance and expansion [default: %de]\n", DEF_TABSTOP);
+    fprintf (st, "        -u       unbuffered, output lines as they come (needs -s wxh)\n");
     fprintf (st, "        -v       print version information\n");
+    fprintf (st, "        -w sock  server mode, process requests sent to socket sock\n");
+    fprintf (st, "        -x name  convert box to design name, i.e. remove it and draw that\n");
+    fprintf (st, "        -z size  input size beyond which to use a temp file [default: 64M]\n");
 }
 
 
@@ -190,6 +198,34 @@ static int is_dir (const char *path)
 
 
 
+static int is_builtin_config (FILE *f)
+/*
+ *  Return true if f is an unmodified copy of the config file which the
+ *  built-in designs were made from. Parsing it would only yield the same
+ *  designs again. The file is rewound.
+ *
+ *      f       open config file
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    struct stat   sinf;
+    unsigned long hash;
+    unsigned long size;
+    int           rc;
+
+    if (anz_builtin_designs == 0 || fstat (fileno (f), &sinf)
+            || (unsigned long) sinf.st_size != builtin_size)
+        return 0;
+
+    rc = hash_file (f, &hash, &size) == 0
+        && size == builtin_size && hash == builtin_hash;
+    rewind (f);
+    return rc;
+}
+
+
+
 static int get_config_file()
 /*
  *  Set yyin and yyfilename to the config file to be used.
@@ -199,11 +235,13 @@ static int get_config_file()
  *      (1) contents of BOXES environment variable
  *      (2) file ~/.boxes
  *      (3) system-wide config file from GLOBALCONF macro.
- *  If neither file exists, return complainingly.
- *
- *  May change current working directory to $HOME.
+ *  If neither file exists, the caller falls back to the built-in designs.
+ *  The same is done if the system-wide config file is the one the built-in
+ *  designs were made from.
  *
  *  RETURNS:    == 0    success  (yyin and yyfilename are set)
+ *              == 2    no config file found, or it is the built-in one
+ *                      (yyin is unmodified)
  *              != 0    error    (yyin is unmodified)
  *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
@@ -211,6 +249,7 @@ static int get_config_file()
 {
     FILE *new_yyin = NULL;
     char *s;                             /* points to data from environment */
+    char *homeconf;                      /* path of config file in $HOME */
     int   rc;
     #ifdef __MINGW32__
     char exepath[256];                   /* for constructing config file path */
@@ -256,26 +295,23 @@ static int get_config_file()
      */
     s = getenv ("HOME");
     if (s) {
-        rc = chdir (s);
-        if (rc) {
+        homeconf = (char *) malloc (strlen (s) + strlen (BOXES_CONFIG) + 2);
+        if (homeconf == NULL) {
             perror (PROJECT);
             return 1;
         }
-        new_yyin = fopen (BOXES_CONFIG, "r");
+        sprintf (homeconf, "%s/%s", s, BOXES_CONFIG);
+        new_yyin = fopen (homeconf, "r");
         if (new_yyin) {
-            rc = is_dir (BOXES_CONFIG);
+            rc = is_dir (homeconf);
             if (rc == -1) {
                 fclose (new_yyin);
+                BFREE (homeconf);
                 return 1;
             }
             else {
                 if (rc == 0) {
-                    yyfilename = (char *) strdup (BOXES_CONFIG);
-                    if (yyfilename == NULL) {
-                        perror (PROJECT);
-                        fclose (new_yyin);
-                        return 1;
-                    }
+                    yyfilename = homeconf;
                     yyin = new_yyin;
                     return 0;
                 }
@@ -285,6 +321,7 @@ static int get_config_file()
                 }
             }
         }
+        BFREE (homeconf);
     }
     else {
         #ifndef __MINGW32__
@@ -323,6 +360,10 @@ static int get_config_file()
         new_yyin = fopen (GLOBALCONF, "r");
     #endif
     if (new_yyin) {
+        if (is_builtin_config (new_yyin)) {
+            fclose (new_yyin);
+            return 2;
+        }
         #ifdef __MINGW32__
             yyfilename = (char *) strdup (exepath);
         #else
@@ -351,12 +392,74 @@ static int get_config_file()
     /*
      *  Darn. No luck today.
      */
-    fprintf (stderr, "%s: Can't find config file.\n", PROJECT);
     return 2;
 }
 
 
 
+static int set_design_list (const char *list)
+/*
+ *  Set the box design(s) named by the -d option. This is a single design
+ *  name, or a comma-separated list of names for drawing nested boxes. The
+ *  first design is that of the innermost box, which goes to opt.design,
+ *  while the others are put in opt.stack. Until the config file has been
+ *  parsed, the entries hold the design names instead of the designs.
+ *
+ *  RETURNS:  != 0   on error (out of memory, or empty design name)
+ *            == 0   on success
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const char *p;
+    size_t      len;
+    int         anz = 1;
+    int         i;
+
+    for (i=0; i<opt.anz_stack; ++i)
+        BFREE (opt.stack[i]);
+    BFREE (opt.stack);
+    opt.anz_stack = 0;
+    BFREE (opt.design);
+
+    for (p=list; *p; ++p) {
+        if (*p == ',')
+            ++anz;
+    }
+    if (anz > 1) {
+        opt.stack = (design_t **) calloc (anz - 1, sizeof(design_t *));
+        if (opt.stack == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+    }
+
+    for (i=0, p=list; i<anz; ++i, p+=len+1) {
+        char *name;
+        len = strcspn (p, ",");
+        if (len == 0) {
+            fprintf (stderr, "%s: empty box design name in list -- %s\n",
+                    PROJECT, list);
+            return 1;
+        }
+        name = (char *) malloc (len + 1);
+        if (name == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        memcpy (name, p, len);
+        name[len] = '\0';
+        if (i == 0)
+            opt.design = (design_t *) name;
+        else
+            opt.stack[opt.anz_stack++] = (design_t *) name;
+    }
+
+    return 0;
+}
+
+
+
 static int process_commandline (int argc, char *argv[])
 /*
  *  Process command line options.
@@ -374,20 +477,14 @@ static int process_commandline (int argc, char *argv[])
     FILE  *f;                            /* potential input file */
     int    idummy;
     char  *pdummy;
-    char   c;
-    int    errfl = 0;                    /* true on error */
-    size_t optlen;
     int    rc;
+    const char *optstring = "a:b:c:d:ef:ghi:j:k:lmo:p:q:rs:t:uvw:x:z:";
+    const char *p;
 
     /*
      *  Set default values
      */
-    memset (&opt, 0, sizeof(opt_t));
-    opt.tabstop = DEF_TABSTOP;
-    opt.tabexp = 'e';
-    opt.killblank = -1;
-    for (idummy=0; idummy<ANZ_SIDES; ++idummy)
-        opt.padding[idummy] = -1;
+    set_default_options();
     yyin = stdin;
 
     /*
@@ -404,78 +501,25 @@ static int process_commandline (int argc, char *argv[])
      *  Parse Command Line
      */
     do {
-        oc = getopt (argc, argv, "a:c:d:f:hi:k:lmp:rs:t:v");
+        oc = getopt (argc, argv, optstring);
+        if (oc != EOF && oc != '?' && oc != ':') {
+            /*
+             *  Remember the option in case the input is sent to a server
+             */
+            p = strchr (optstring, oc);
+            if (client_option (oc, p && p[1] == ':'? optarg: NULL))
+                return 1;
+        }
 
         switch (oc) {
 
-            case 'a':
+            case 'a': case 'b': case 'i': case 'k':
+            case 'p': case 'q': case 's': case 't': case 'z':
                 /*
-                 *  Alignment/positioning of text inside box
+                 *  Options which control how the box is drawn or removed
                  */
-                errfl = 0;
-                pdummy = optarg;
-                while (*pdummy) {
-                    if (pdummy[1] == '\0' && !strchr ("lLcCrR", *pdummy)) {
-                        errfl = 1;
-                        break;
-                    }
-                    switch (*pdummy) {
-                        case 'h': case 'H':
-                            switch (pdummy[1]) {
-                                case 'c': case 'C': opt.halign = 'c'; break;
-                                case 'l': case 'L': opt.halign = 'l'; break;
-                                case 'r': case 'R': opt.halign = 'r'; break;
-                                default:            errfl = 1;        break;
-                            }
-                            ++pdummy;
-                            break;
-                        case 'v': case 'V':
-                            switch (pdummy[1]) {
-                                case 'c': case 'C': opt.valign = 'c'; break;
-                                case 't': case 'T': opt.valign = 't'; break;
-                                case 'b': case 'B': opt.valign = 'b'; break;
-                                default:            errfl = 1;        break;
-                            }
-                            ++pdummy;
-                            break;
-                        case 'j': case 'J':
-                            switch (pdummy[1]) {
-                                case 'l': case 'L': opt.justify = 'l'; break;
-                                case 'c': case 'C': opt.justify = 'c'; break;
-                                case 'r': case 'R': opt.justify = 'r'; break;
-                                default:            errfl = 1;         break;
-                            }
-                            ++pdummy;
-                            break;
-                        case 'l': case 'L':
-                            opt.justify = 'l';
-                            opt.halign = 'l';
-                            opt.valign = 'c';
-                            break;
-                        case 'r': case 'R':
-                            opt.justify = 'r';
-                            opt.halign = 'r';
-                            opt.valign = 'c';
-                            break;
-                        case 'c': case 'C':
-                            opt.justify = 'c';
-                            opt.halign = 'c';
-                            opt.valign = 'c';
-                            break;
-                        default:
-                            errfl = 1;
-                            break;
-                    }
-                    if (errfl)
-                        break;
-                    else
-                        ++pdummy;
-                }
-                if (errfl) {
-                    fprintf (stderr, "%s: Illegal text format -- %s\n",
-                            PROJECT, optarg);
+                if (set_option (oc, optarg))
                     return 1;
-                }
                 break;
 
             case 'c':
@@ -504,15 +548,18 @@ static int process_commandline (int argc, char *argv[])
                 /*
                  *  Box design selection
                  */
-                BFREE (opt.design);
-                opt.design = (design_t *) ((char *) strdup (optarg));
-                if (opt.design == NULL) {
-                    perror (PROJECT);
+                if (set_design_list (optarg))
                     return 1;
-                }
                 opt.design_choice_by_user = 1;
                 break;
 
+            case 'e':
+                /*
+                 *  Use the built-in designs, even if there is a config file
+                 */
+                use_builtin = 1;
+                break;
+
             case 'f':
                 /*
                  *  Input File
@@ -543,6 +590,14 @@ static int process_commandline (int argc, char *argv[])
                 yyin = f;
                 break;
 
+            case 'g':
+                /*
+                 *  Remove all boxes found in the input
+                 */
+                opt.global = 1;
+                opt.r = 1;
+                break;
+
             case 'h':
                 /*
                  *  Display usage information and terminate
@@ -550,37 +605,25 @@ static int process_commandline (int argc, char *argv[])
                 usage_long (stdout);
                 return 42;
 
-            case 'i':
+            case 'j':
                 /*
-                 *  Indentation mode
+                 *  Batch mode: number of worker threads, 0 = one per CPU
                  */
-                optlen = strlen (optarg);
-                if (optlen <= 3 && !strncasecmp ("box", optarg, optlen))
-                    opt.indentmode = 'b';
-                else if (optlen <= 4 && !strncasecmp ("text", optarg, optlen))
-                    opt.indentmode = 't';
-                else if (optlen <= 4 && !strncasecmp ("none", optarg, optlen))
-                    opt.indentmode = 'n';
-                else {
-                    fprintf (stderr, "%s: invalid indentation mode\n", PROJECT);
+                errno = 0;
+                idummy = (int) strtol (optarg, &pdummy, 10);
+                if (errno || idummy < 0 || *pdummy != '\0' || pdummy == optarg) {
+                    fprintf (stderr, "%s: invalid number of jobs -- %s\n",
+                            PROJECT, optarg);
                     return 1;
                 }
-                break;
-
-            /*
-             *  Kill blank lines or not [default: design-dependent]
-             */
-            case 'k':
-                if (opt.killblank == -1) {
-                    if (strisyes (optarg))
-                        opt.killblank = 1;
-                    else if (strisno (optarg))
-                        opt.killblank = 0;
-                    else {
-                        fprintf (stderr, "%s: -k: invalid parameter\n", PROJECT);
-                        return 1;
-                    }
+                if (idummy == 0) {
+                #if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+                    idummy = (int) sysconf (_SC_NPROCESSORS_ONLN);
+                #endif
+                    if (idummy < 1)
+                        idummy = 1;
                 }
+                opt.jobs = idummy;
                 break;
 
             case 'l':
@@ -594,68 +637,16 @@ static int process_commandline (int argc, char *argv[])
                 /*
                  *  Mend box: remove, then redraw
                  */
-                opt.mend = 2;
+                opt.mend = 1;
                 opt.r = 1;
                 opt.killblank = 0;
                 break;
 
-            case 'p':
+            case 'o':
                 /*
-                 *  Padding. format is ([ahvtrbl]n)+
+                 *  Batch mode output directory
                  */
-                errfl = 0;
-                pdummy = optarg;
-                while (*pdummy) {
-                    if (pdummy[1] == '\0') {
-                        errfl = 1;
-                        break;
-                    }
-                    c = *pdummy;
-                    errno = 0;
-                    idummy = (int) strtol (pdummy+1, &pdummy, 10);
-                    if (errno || idummy < 0) {
-                        errfl = 1;
-                        break;
-                    }
-                    switch (c) {
-                        case 'a': case 'A':
-                            opt.padding[BTOP] = idummy;
-                            opt.padding[BBOT] = idummy;
-                            opt.padding[BLEF] = idummy;
-                            opt.padding[BRIG] = idummy;
-                            break;
-                        case 'h': case 'H':
-                            opt.padding[BLEF] = idummy;
-                            opt.padding[BRIG] = idummy;
-                            break;
-                        case 'v': case 'V':
-                            opt.padding[BTOP] = idummy;
-                            opt.padding[BBOT] = idummy;
-                            break;
-                        case 't': case 'T':
-                            opt.padding[BTOP] = idummy;
-                            break;
-                        case 'l': case 'L':
-                            opt.padding[BLEF] = idummy;
-                            break;
-                        case 'b': case 'B':
-                            opt.padding[BBOT] = idummy;
-                            break;
-                        case 'r': case 'R':
-                            opt.padding[BRIG] = idummy;
-                            break;
-                        default:
-                            errfl = 1;
-                            break;
-                    }
-                    if (errfl)
-                        break;
-                }
-                if (errfl) {
-                    fprintf (stderr, "%s: invalid padding specification - "
-                            "%s\n", PROJECT, optarg);
-                    return 1;
-                }
+                opt.outdir = optarg;
                 break;
 
             case 'r':
@@ -665,80 +656,41 @@ static int process_commandline (int argc, char *argv[])
                 opt.r = 1;
                 break;
 
-            case 's':
+            case 'u':
                 /*
-                 *  Specify desired box target size
+                 *  Streaming output, box size is fixed via -s
                  */
-                pdummy = strchr (optarg, 'x');
-                if (!pdummy) pdummy = strchr (optarg, 'X');
-                if(pdummy) {
-                    *pdummy = '\0';
-                }
-                errno = 0;
-                if (optarg != pdummy) opt.reqwidth = strtol (optarg, NULL, 10);
-                if (pdummy) {
-                    opt.reqheight = strtol (pdummy+1, NULL, 10);
-                    *pdummy = 'x';
-                }
-                if(errno){
-                    fprintf (stderr, "%s: box size: %s, '%s'\n",
-                            PROJECT, strerror(idummy), optarg);
-                    return 1;
-                } else if ((opt.reqwidth == 0 && opt.reqheight == 0)
-                  || opt.reqwidth < 0 || opt.reqheight < 0) {
-                    fprintf (stderr, "%s: invalid box size specification -- %s\n",
-                            PROJECT, optarg);
-                    return 1;
-                }
+                opt.stream = 1;
                 break;
 
-            case 't':
+            case 'v':
                 /*
-                 *  Tab handling. Format is n[eku]
+                 *  Print version number
                  */
-                idummy = (int) strtol (optarg, &pdummy, 10);
-                if (idummy < 1 || idummy > MAX_TABSTOP) {
-                    fprintf (stderr, "%s: invalid tab stop distance -- %d\n",
-                            PROJECT, idummy);
-                    return 1;
-                }
-                opt.tabstop = idummy;
+                printf ("%s version %s\n", PROJECT, VERSION);
+                return 42;
 
-                errfl = 0;
-                if (*pdummy != '\0') {
-                    if (pdummy[1] != '\0') {
-                        errfl = 1;
-                    }
-                    else {
-                        switch (*pdummy) {
-                            case 'e': case 'E':
-                                opt.tabexp = 'e';
-                                break;
-                            case 'k': case 'K':
-                                opt.tabexp = 'k';
-                                break;
-                            case 'u': case 'U':
-                                opt.tabexp = 'u';
-                                break;
-                            default:
-                                errfl = 1;
-                                break;
-                        }
-                    }
-                }
-                if (errfl) {
-                    fprintf (stderr, "%s: invalid tab handling specification - "
-                            "%s\n", PROJECT, optarg);
-                    return 1;
-                }
+            case 'w':
+                /*
+                 *  Server mode, listen on the given socket
+                 */
+                opt.server = optarg;
                 break;
 
-            case 'v':
+            case 'x':
                 /*
-                 *  Print version number
+                 *  Convert box: remove, then draw using the target design
                  */
-                printf ("%s version %s\n", PROJECT, VERSION);
-                return 42;
+                BFREE (opt.target);
+                opt.target = (design_t *) ((char *) strdup (optarg));
+                if (opt.target == NULL) {
+                    perror (PROJECT);
+                    return 1;
+                }
+                opt.mend = 1;
+                opt.r = 1;
+                opt.killblank = 0;
+                break;
 
             case ':': case '?':
                 /*
@@ -759,14 +711,122 @@ static int process_commandline (int argc, char *argv[])
         }
     } while (oc != EOF);
 
+    /*
+     *  Streaming output requires that the box can be drawn without having
+     *  seen all of the input text.
+     */
+    if (opt.stream) {
+        if (opt.reqwidth == 0 || opt.reqheight == 0) {
+            fprintf (stderr, "%s: -u requires box width and height (-s wxh)\n",
+                    PROJECT);
+            return 1;
+        }
+        if (opt.r || opt.l || opt.recmode) {
+            fprintf (stderr, "%s: -u cannot be combined with -b, -g, -l, -m, "
+                    "-r, or -x\n", PROJECT);
+            return 1;
+        }
+        if ((opt.halign && opt.halign != 'l') || (opt.valign && opt.valign != 't')
+                || opt.justify) {
+            fprintf (stderr, "%s: -u requires text positioned at the top left "
+                    "(-a hlvt)\n", PROJECT);
+            return 1;
+        }
+        if (opt.indentmode && opt.indentmode != 't') {
+            fprintf (stderr, "%s: -u requires indentation mode 'text'\n",
+                    PROJECT);
+            return 1;
+        }
+    }
+
+    /*
+     *  Removing all boxes leaves the text between them in place, so there
+     *  is no single box which could be redrawn, and no record to box.
+     */
+    if (opt.global && (opt.mend || opt.recmode)) {
+        fprintf (stderr, "%s: -g cannot be combined with -b, -m, or -x\n",
+                PROJECT);
+        return 1;
+    }
+    if (opt.global && !opt.design_choice_by_user) {
+        fprintf (stderr, "%s: -g requires a box design (-c or -d)\n", PROJECT);
+        return 1;
+    }
+
+    /*
+     *  Nested boxes can only be drawn, and the outer boxes need the input
+     *  to be complete before they can be drawn.
+     */
+    if (opt.anz_stack > 0 && (opt.r || opt.l || opt.stream || opt.cld)) {
+        fprintf (stderr, "%s: a list of box designs (-d) cannot be combined "
+                "with -c, -g, -l, -m, -r, -u, or -x\n", PROJECT);
+        return 1;
+    }
+
+    /*
+     *  The target design of a conversion is taken from the config file.
+     */
+    if (opt.target && opt.cld) {
+        fprintf (stderr, "%s: -x cannot be combined with -c\n", PROJECT);
+        return 1;
+    }
+
+    /*
+     *  Batch mode works on files only, and cannot be used for listings.
+     */
+    if (opt.outdir && opt.jobs == 0) {
+        fprintf (stderr, "%s: -o requires batch mode (-j)\n", PROJECT);
+        return 1;
+    }
+    if (opt.jobs && (opt.stream || opt.l)) {
+        fprintf (stderr, "%s: -j cannot be combined with -l or -u\n", PROJECT);
+        return 1;
+    }
+
+    /*
+     *  The server serves all designs of its config file, and has no files.
+     */
+    if (opt.server && (opt.cld || opt.design_choice_by_user || opt.l
+                || opt.outdir || opt.stream || opt.target))
+    {
+        fprintf (stderr, "%s: -w cannot be combined with -c, -d, -l, -o, -u, "
+                "or -x\n", PROJECT);
+        return 1;
+    }
+
     /*
      *  Input and Output Files
      *
      *  After any command line options, an input file and an output file may
      *  be specified (in that order). "-" may be substituted for standard
      *  input or output. A third file name would be invalid.
+     *  In batch mode, any number of input files may be given instead, and
+     *  the results are written to the output directory or in place.
      */
-    if (argv[optind] == NULL) {          /* neither infile nor outfile given */
+    if (opt.server) {
+        if (argv[optind] != NULL) {
+            fprintf (stderr, "%s: illegal parameter -- %s\n",
+                    PROJECT, argv[optind]);
+            usage_short (stderr);
+            return 1;
+        }
+        opt.infile = stdin;
+        opt.outfile = stdout;
+    }
+
+    else if (opt.jobs) {
+        if (argv[optind] == NULL) {
+            fprintf (stderr, "%s: batch mode requires input files\n", PROJECT);
+            usage_short (stderr);
+            return 1;
+        }
+        opt.files = argv + optind;
+        opt.anz_files = argc - optind;
+        opt.infile = stdin;
+        opt.outfile = stdout;
+    }
+
+    else if (argv[optind] == NULL) {     /* neither infile nor outfile given */
         opt.infile = stdin;
         opt.outfile = stdout;
     }
@@ -810,10 +870,15 @@ static int process_commandline (int argc, char *argv[])
 
     /*
      *  If no config file has been specified yet, try getting it elsewhere.
+     *  If there is none, the built-in designs are used.
      */
-    if (opt.cld == NULL) {
-        rc = get_config_file();          /* sets yyin and yyfilename     */
-        if (rc)                          /* may change working directory */
+    if (opt.cld == NULL && !use_builtin) {
+        rc = get_config_file();          /* sets yyin and yyfilename */
+        if (rc == 2 && anz_builtin_designs > 0)
+            use_builtin = 1;
+        else if (rc == 2)
+            fprintf (stderr, "%s: Can't find config file.\n", PROJECT);
+        if (rc && !use_builtin)
             return rc;
     }
 
@@ -832,10 +897,24 @@ static int process_commandline (int argc, char *argv[])
         fprintf (stderr, "- Line justification: \'%c\'\n",
                 opt.justify? opt.justify: '?');
         fprintf (stderr, "- Kill blank lines: %d\n", opt.killblank);
+        fprintf (stderr, "- Autodetection certainty: %d%%\n", opt.certainty);
         fprintf (stderr, "- Remove box: %d\n", opt.r);
+        fprintf (stderr, "- Remove all boxes: %d\n", opt.global);
         fprintf (stderr, "- Mend box: %d\n", opt.mend);
+        fprintf (stderr, "- Convert to design: %s\n",
+                opt.target? (char *) opt.target: "(none)");
+        fprintf (stderr, "- Outer box designs: %d\n", opt.anz_stack);
+        fprintf (stderr, "- Streaming output: %d\n", opt.stream);
+        fprintf (stderr, "- Record mode: \'%c\' %s\n",
+                opt.recmode? opt.recmode: '?', opt.recsep? opt.recsep: "");
+        fprintf (stderr, "- Spool input beyond: %lu bytes\n", (unsigned long) opt.spoolsize);
+        fprintf (stderr, "- Batch mode: %d jobs, %d files, output to %s\n",
+                opt.jobs, opt.anz_files, opt.outdir? opt.outdir: "(in place)");
         fprintf (stderr, "- Design Definition W shape: %s\n",
                 opt.cld? opt.cld: "n/a");
+        fprintf (stderr, "- Built-in designs: %d\n", use_builtin);
+        fprintf (stderr, "- Server socket: %s\n",
+                opt.server? opt.server: "(none)");
     #endif
 
     return 0;
@@ -859,6 +938,9 @@ static int build_design (design_t **adesigns, const char *cld)
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
+    static designinfo_t cld_info = {
+        NULL, NULL, "now", "1.0", NULL, "n/a"
+    };
     design_t *dp;                        /* pointer to design to be created */
     sentry_t *c;                         /* pointer to current shape */
     int i;
@@ -872,9 +954,7 @@ static int build_design (design_t **adesigns, const char *cld)
     dp = *adesigns;                      /* for readability */
 
     dp->name = "<Command Line Definition>";
-    dp->created = "now";
-    dp->revision = "1.0";
-    dp->sample = "n/a";
+    dp->info = &cld_info;
     dp->indentmode = DEF_INDENTMODE;
     dp->padding[BLEF] = 1;
 
@@ -926,7 +1006,62 @@ static int build_design (design_t **adesigns, const char *cld)
     dp->minwidth = dp->shape[W].width + 2;
     dp->minheight = 3;
 
-    return 0;
+    measure_shapes (dp->shape, &(dp->metrics));
+    return build_trims (dp);
+}
+
+
+
+static void load_builtin()
+/*
+ *  Use the designs compiled into the program instead of parsing a config
+ *  file. The table holds all designs, with everything the parser computes,
+ *  so nothing needs to be done but to point the design list at it. There
+ *  is no file to identify the designs in the detection cache, so they are
+ *  identified by the version and the config file they were made from.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    static char ident[64];
+
+    designs = builtin_designs;
+    anz_designs = anz_builtin_designs;
+    design_idx = anz_designs - 1;
+    yyfilename = BUILTIN_CONFIG;
+
+    sprintf (ident, "%s %s %lu %08lx", BUILTIN_CONFIG, VERSION,
+            builtin_size, builtin_hash);
+    cache_set_identity (ident);
+}
+
+
+
+static int resolve_design (design_t **d)
+/*
+ *  Replace a design name given on the command line by the design of that
+ *  name read from the config file.
+ *
+ *    d    RESULT: pointer to the name, which is freed and replaced
+ *
+ *  RETURNS:  != 0   on error (no such design)
+ *            == 0   on success
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *name = (char *) *d;
+    int   i;
+
+    for (i=0; i<anz_designs; ++i) {
+        if (!strcasecmp (name, designs[i].name)) {
+            BFREE (name);
+            *d = designs + i;
+            return 0;
+        }
+    }
+    fprintf (stderr, "%s: unknown box design -- %s\n", PROJECT, name);
+    return 1;
 }
 
 
@@ -953,6 +1088,7 @@ static int list_styles()
     if (opt.design_choice_by_user) {
 
         design_t *d = opt.design;
+        designinfo_t *info = d->info;
         int until = -1;
         int sstart = 0;
         size_t w = 0;
@@ -970,16 +1106,16 @@ static int list_styles()
         fprintf (opt.outfile, "\n");
 
         fprintf (opt.outfile, "Author:                 %s\n",
-                d->author? d->author: "(unknown author)");
+                info->author? info->author: "(unknown author)");
         fprintf (opt.outfile, "Original Designer:      %s\n",
-                 d->designer? d->designer: "(unknown artist)");
+                 info->designer? info->designer: "(unknown artist)");
         fprintf (opt.outfile, "Creation Date:          %s\n",
-                d->created? d->created: "(unknown)");
+                info->created? info->created: "(unknown)");
 
         fprintf (opt.outfile, "Current Revision:       %s%s%s\n",
-                d->revision? d->revision: "",
-                d->revision && d->revdate? " as of ": "",
-                d->revdate? d->revdate: (d->revision? "": "(unknown)"));
+                info->revision? info->revision: "",
+                info->revision && info->revdate? " as of ": "",
+                info->revdate? info->revdate: (info->revision? "": "(unknown)"));
 
         fprintf (opt.outfile, "Indentation Mode:       ");
         switch (d->indentmode) {
@@ -1051,8 +1187,8 @@ static int list_styles()
         }
 
         fprintf (opt.outfile, "Default Killblank:      %s\n",
-                empty_side (opt.design->shape, BTOP) &&
-                empty_side (opt.design->shape, BBOT)? "no": "yes");
+                opt.design->metrics.empty[BTOP] &&
+                opt.design->metrics.empty[BBOT]? "no": "yes");
 
         fprintf (opt.outfile, "Elastic Shapes:         ");
         sstart = 0;
@@ -1126,6 +1262,7 @@ static int list_styles()
 
     else {
         design_t **list;                 /* temp list for sorting */
+        designinfo_t *info;
         char buf[42];
 
         list = (design_t **) calloc (design_idx+1, sizeof(design_t *));
@@ -1148,20 +1285,21 @@ static int list_styles()
             fprintf (opt.outfile, "-");
         fprintf (opt.outfile, "\n\n");
         for (i=0; i<anz_designs; ++i) {
-            if (list[i]->author && list[i]->designer && strcmp(list[i]->author, list[i]->designer) != 0) {
+            info = list[i]->info;
+            if (info->author && info->designer && strcmp(info->author, info->designer) != 0) {
                 fprintf(opt.outfile, "%s\n%s, coded by %s:\n\n%s\n\n", list[i]->name,
-                        list[i]->designer, list[i]->author, list[i]->sample);
+                        info->designer, info->author, info->sample);
             }
-            else if (list[i]->designer) {
+            else if (info->designer) {
                 fprintf(opt.outfile, "%s\n%s:\n\n%s\n\n", list[i]->name,
-                        list[i]->designer, list[i]->sample);
+                        info->designer, info->sample);
             }
-            else if (list[i]->author) {
+            else if (info->author) {
                 fprintf(opt.outfile, "%s\nunknown artist, coded by %s:\n\n%s\n\n", list[i]->name,
-                        list[i]->author, list[i]->sample);
+                        info->author, info->sample);
             }
             else {
-                fprintf(opt.outfile, "%s:\n\n%s\n\n", list[i]->name, list[i]->sample);
+                fprintf(opt.outfile, "%s:\n\n%s\n\n", list[i]->name, info->sample);
             }
         }
         BFREE (list);
@@ -1172,322 +1310,6 @@ static int list_styles()
 
 
 
-static int get_indent (const line_t *lines, const size_t lanz)
-/*
- *  Determine indentation of given lines in spaces.
- *
- *      lines   the lines to examine
- *      lanz    number of lines to examine
- *
- *  Lines are assumed to be free of trailing whitespace.
- *
- *  RETURNS:    >= 0   indentation in spaces
- *               < 0   error
- *
-* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- */
-{
-    size_t j;
-    int    res = LINE_MAX;               /* result */
-    int    nonblank = 0;                 /* true if one non-blank line found */
-
-    if (lines == NULL) {
-        fprintf (stderr, "%s: internal error\n", PROJECT);
-        return -1;
-    }
-    if (lanz == 0)
-        return 0;
-
-    for (j=0; j<lanz; ++j) {
-        if (lines[j].len > 0) {
-            size_t ispc;
-            nonblank = 1;
-            ispc = strspn (lines[j].text, " ");
-            if ((int) ispc < res)
-                res = ispc;
-        }
-    }
-
-    if (nonblank)
-        return res;                      /* success */
-    else
-        return 0;                        /* success, but only blank lines */
-}
-
-
-
-static int apply_substitutions (const int mode)
-/*
- *  Apply regular expression substitutions to input text.
- *
- *    mode == 0   use replacement rules (box is being *drawn*)
- *         == 1   use reversion rules (box is being *removed*)
- *
- *  Attn: This modifies the actual input array!
- *
- *  RETURNS:  == 0   success
- *            != 0   error
- *
-* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- */
-{
-    size_t     anz_rules;
-    reprule_t *rules;
-    size_t     j, k;
-    char       buf[LINE_MAX*2];
-    size_t     buf_len;                  /* length of string in buf */
-
-    if (opt.design == NULL)
-        return 1;
-
-    if (mode == 0) {
-        anz_rules = opt.design->anz_reprules;
-        rules = opt.design->reprules;
-    }
-    else if (mode == 1) {
-        anz_rules = opt.design->anz_revrules;
-        rules = opt.design->revrules;
-    }
-    else {
-        fprintf (stderr, "%s: internal error\n", PROJECT);
-        return 2;
-    }
-
-    /*
-     *  Compile regular expressions
-     */
-    errno = 0;
-    opt.design->current_rule = rules;
-    for (j=0; j<anz_rules; ++j, ++(opt.design->current_rule)) {
-        rules[j].prog = regcomp (rules[j].search);
-    }
-    opt.design->current_rule = NULL;
-    if (errno) return 3;
-
-    /*
-     *  Apply regular expression substitutions to input lines
-     */
-    for (k=0; k<input.anz_lines; ++k) {
-        opt.design->current_rule = rules;
-        for (j=0; j<anz_rules; ++j, ++(opt.design->current_rule)) {
-            #ifdef REGEXP_DEBUG
-                fprintf (stderr, "myregsub (0x%p, \"%s\", %d, \"%s\", buf, %d, \'%c\') == ",
-                        rules[j].prog, input.lines[k].text,
-                        input.lines[k].len, rules[j].repstr, LINE_MAX*2,
-                        rules[j].mode);
-            #endif
-            errno = 0;
-            buf_len = myregsub (rules[j].prog, input.lines[k].text,
-                    input.lines[k].len, rules[j].repstr, buf, LINE_MAX*2,
-                    rules[j].mode);
-            #ifdef REGEXP_DEBUG
-                fprintf (stderr, "%d\n", buf_len);
-            #endif
-            if (errno) return 1;
-
-            BFREE (input.lines[k].text);
-            input.lines[k].text = (char *) strdup (buf);
-            if (input.lines[k].text == NULL) {
-                perror (PROJECT);
-                return 1;
-            }
-            input.lines[k].len = buf_len;
-            if (input.lines[k].len > input.maxline)
-                input.maxline = input.lines[k].len;
-            #ifdef REGEXP_DEBUG
-                fprintf (stderr, "input.lines[%d] == {%d, \"%s\"}\n", k,
-                        input.lines[k].len, input.lines[k].text);
-            #endif
-        }
-        opt.design->current_rule = NULL;
-    }
-
-    /*
-     *  If text indentation was part of the lines processed, indentation
-     *  may now be different -> recalculate input.indent.
-     */
-    if (opt.design->indentmode == 't') {
-        int rc;
-        rc = get_indent (input.lines, input.anz_lines);
-        if (rc >= 0)
-            input.indent = (size_t) rc;
-        else
-            return 4;
-    }
-
-    return 0;
-}
-
-
-
-static int read_all_input (const int use_stdin)
-/*
- *  Read entire input (possibly from stdin) and store it in 'input' array.
- *
- *  Tabs are expanded.
- *  Might allocate slightly more memory than it needs. Trade-off for speed.
- *
- *  use_stdin: flag indicating whether to read from stdin (use_stdin != 0)
- *             or use the data currently present in input (use_stdin == 0).
- *
- *  RETURNS:  != 0   on error (out of memory)
- *            == 0   on success
- *
-* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- */
-{
-    char    buf[LINE_MAX+2];             /* input buffer */
-    size_t  input_size = 0;              /* number of elements allocated */
-    line_t *tmp = NULL;
-    char   *temp = NULL;                 /* string resulting from tab exp. */
-    size_t  newlen;                      /* line length after tab expansion */
-    size_t  i;
-    int     rc;
-
-    input.indent = LINE_MAX;
-    input.maxline = 0;
-
-    if (use_stdin) {
-        input.anz_lines = 0;
-
-        /*
-         *  Start reading
-         */
-        while (fgets (buf, LINE_MAX+1, opt.infile))
-        {
-            if (input_size % 100 == 0) {
-                input_size += 100;
-                tmp = (line_t *) realloc (input.lines, input_size*sizeof(line_t));
-                if (tmp == NULL) {
-                    perror (PROJECT);
-                    BFREE (input.lines);
-                    return 1;
-                }
-                input.lines = tmp;
-            }
-
-            input.lines[input.anz_lines].len = strlen (buf);
-
-            if (opt.r) {
-                input.lines[input.anz_lines].len -= 1;
-                if (buf[input.lines[input.anz_lines].len] == '\n')
-                    buf[input.lines[input.anz_lines].len] = '\0';
-            }
-            else {
-                btrim (buf, &(input.lines[input.anz_lines].len));
-            }
-
-            if (input.lines[input.anz_lines].len > 0) {
-                newlen = expand_tabs_into (buf,
-                        input.lines[input.anz_lines].len, opt.tabstop, &temp,
-                        &(input.lines[input.anz_lines].tabpos),
-                        &(input.lines[input.anz_lines].tabpos_len));
-                if (newlen == 0) {
-                    perror (PROJECT);
-                    BFREE (input.lines);
-                    return 1;
-                }
-                input.lines[input.anz_lines].text = temp;
-                input.lines[input.anz_lines].len = newlen;
-                temp = NULL;
-            }
-            else {
-                input.lines[input.anz_lines].text = (char *) strdup (buf);
-            }
-
-            /*
-             *  Update length of longest line
-             */
-            if (input.lines[input.anz_lines].len > input.maxline)
-                input.maxline = input.lines[input.anz_lines].len;
-
-            /*
-             *  next please
-             */
-            ++input.anz_lines;
-        }
-
-        if (ferror (stdin)) {
-            perror (PROJECT);
-            BFREE (input.lines);
-            return 1;
-        }
-    }
-
-    else {
-        /* recalculate input statistics for redrawing the mended box */
-        for (i=0; i<input.anz_lines; ++i) {
-            input.lines[i].len = strlen (input.lines[i].text);
-            if (input.lines[i].len > input.maxline)
-                input.maxline = input.lines[i].len;
-        }
-    }
-
-    /*
-     *  Exit if there was no input at all
-     */
-    if (input.lines == NULL || input.lines[0].text == NULL)
-        return 0;
-
-    /*
-     *  Compute indentation
-     */
-    rc = get_indent (input.lines, input.anz_lines);
-    if (rc >= 0)
-        input.indent = (size_t) rc;
-    else
-        return 1;
-
-    /*
-     *  Remove indentation, unless we want to preserve it (when removing
-     *  a box or if the user wants to retain it inside the box)
-     */
-    if (opt.design->indentmode != 't' && opt.r == 0) {
-        for (i=0; i<input.anz_lines; ++i) {
-            if (input.lines[i].len >= input.indent) {
-                memmove (input.lines[i].text, input.lines[i].text+input.indent,
-                        input.lines[i].len-input.indent+1);
-                input.lines[i].len -= input.indent;
-            }
-        }
-        input.maxline -= input.indent;
-    }
-
-    /*
-     *  Apply regular expression substitutions
-     */
-    if (opt.r == 0) {
-        if (apply_substitutions(0) != 0)
-            return 1;
-    }
-
-#if 0
-    /*
-     *  Debugging Code: Display contents of input structure
-     */
-    for (i=0; i<input.anz_lines; ++i) {
-        fprintf (stderr, "%3d [%02d] \"%s\"", i, input.lines[i].len,
-                input.lines[i].text);
-        fprintf (stderr, "\tTabs: [");
-        if (input.lines[i].tabpos != NULL) {
-            size_t j;
-            for (j=0; j<input.lines[i].tabpos_len; ++j) {
-                fprintf (stderr, "%d", input.lines[i].tabpos[j]);
-                if (j < input.lines[i].tabpos_len - 1) {
-                    fprintf (stderr, ", ");
-                }
-            }
-        }
-        fprintf (stderr, "] (%d)\n", input.lines[i].tabpos_len);
-    }
-    fprintf (stderr, "\nLongest line: %d characters.\n", input.maxline);
-    fprintf (stderr, " Indentation: %2d spaces.\n", input.indent);
-#endif
-
-    return 0;
-}
-
-
 /*       _\|/_
          (o o)
  +----oOO-{_}-OOo------------------------------------------------------------+
@@ -1497,10 +1319,9 @@ static int read_all_input (const int use_stdin)
 int main (int argc, char *argv[])
 {
     int    rc;                           /* general return code */
-    size_t pad;
     int    i;
-    int    saved_designwidth;            /* opt.design->minwith backup, used for mending */
-    int    saved_designheight;           /* opt.design->minheight backup, used for mending */
+    char  *server;                       /* socket of server, if any */
+    char  *s;
 
     #ifdef DEBUG
         fprintf (stderr, "BOXES STARTING ...\n");
@@ -1519,13 +1340,39 @@ int main (int argc, char *argv[])
         exit (EXIT_FAILURE);
 
     /*
-     *  Parse config file, then reset design pointer
+     *  If a server is running, have it process the input, so the config
+     *  file need not be parsed. The server does not support all options,
+     *  and may be gone, in which case we process the input ourselves.
+     */
+    server = getenv ("BOXES_SERVER");
+    if (server && *server && opt.server == NULL && opt.cld == NULL
+            && !opt.l && !opt.jobs && !opt.stream)
+    {
+        rc = client_run (server, use_builtin? BUILTIN_CONFIG: yyfilename);
+        if (rc >= 0)
+            exit (rc? EXIT_FAILURE: EXIT_SUCCESS);
+    }
+
+    /*
+     *  Parse config file, then set design pointers
      */
     #ifdef DEBUG
         fprintf (stderr, "Parsing Config File ...\n");
     #endif
-    if (opt.cld == NULL) {
-        rc = yyparse();
+    if (opt.cld == NULL && use_builtin) {
+        load_builtin();
+    }
+    else if (opt.cld == NULL) {
+        /*
+         *  Processes running in parallel may share the designs they read.
+         *  The server replaces its designs when the file changes, so it
+         *  needs designs of its own.
+         */
+        s = getenv ("BOXES_SHM");
+        if (s && *s && opt.server == NULL)
+            rc = shm_load_designs();
+        else
+            rc = yyparse();
         if (rc)
             exit (EXIT_FAILURE);
     }
@@ -1535,8 +1382,30 @@ int main (int argc, char *argv[])
             exit (EXIT_FAILURE);
         anz_designs = 1;
     }
-    BFREE (opt.design);
-    opt.design = designs;
+    /*
+     *  The parser kept the designs named on the command line in config file
+     *  order, so they are looked up by name.
+     */
+    rc = opt.target? resolve_design (&opt.target): 0;
+    for (i=0; rc == 0 && i<opt.anz_stack; ++i)
+        rc = resolve_design (opt.stack + i);
+    if (rc == 0 && opt.design_choice_by_user && opt.cld == NULL) {
+        rc = resolve_design (&opt.design);
+    }
+    else {
+        BFREE (opt.design);
+        opt.design = designs;
+    }
+    if (rc)
+        exit (EXIT_FAILURE);
+
+    /*
+     *  In server mode, serve requests until terminated.
+     */
+    if (opt.server) {
+        rc = server_run (opt.server, !use_builtin);
+        exit (rc? EXIT_FAILURE: EXIT_SUCCESS);
+    }
 
     /*
      *  If "-l" option was given, list styles and exit.
@@ -1548,141 +1417,35 @@ int main (int argc, char *argv[])
 
     /*
      *  Adjust box size and indentmode to command line specification
-     *  Increase box width/height by width/height of empty sides in order
-     *  to match appearance of box with the user's expectations (if -s).
      */
-    if (opt.reqheight > (long) opt.design->minheight)
-        opt.design->minheight = opt.reqheight;
-    if (opt.reqwidth > (long) opt.design->minwidth)
-        opt.design->minwidth = opt.reqwidth;
-    if (opt.reqwidth) {
-        if (empty_side (opt.design->shape, BRIG))
-            opt.design->minwidth  += opt.design->shape[SE].width;
-        if (empty_side (opt.design->shape, BLEF))
-            opt.design->minwidth  += opt.design->shape[NW].width;
-    }
-    if (opt.reqheight) {
-        if (empty_side (opt.design->shape, BTOP))
-            opt.design->minheight += opt.design->shape[NW].height;
-        if (empty_side (opt.design->shape, BBOT))
-            opt.design->minheight += opt.design->shape[SE].height;
-    }
-    if (opt.indentmode)
-        opt.design->indentmode = opt.indentmode;
-    saved_designwidth = opt.design->minwidth;
-    saved_designheight = opt.design->minheight;
+    apply_design_options();
 
-    do {
-        if (opt.mend == 1)  /* Mending a box works in two phases: */
-            opt.r = 0;      /* opt.mend == 2: remove box          */
-        --opt.mend;         /* opt.mend == 1: add it back         */
-        opt.design->minwidth = saved_designwidth;
-        opt.design->minheight = saved_designheight;
-
-        /*
-         *  Read input lines
-         */
+    /*
+     *  If "-u" option was given, draw the box while reading the input.
+     */
+    if (opt.stream) {
         #ifdef DEBUG
-            fprintf (stderr, "Reading all input ...\n");
+            fprintf (stderr, "Streaming Box ...\n");
         #endif
-        rc = read_all_input (opt.mend);
-        if (rc)
-            exit (EXIT_FAILURE);
-        if (input.anz_lines == 0)
-            exit (EXIT_SUCCESS);
-
-        /*
-         *  Adjust box size to fit requested padding value
-         *  Command line-specified box size takes precedence over padding.
-         */
-        for (i=0; i<ANZ_SIDES; ++i) {
-            if (opt.padding[i] > -1)
-                opt.design->padding[i] = opt.padding[i];
-        }
-        pad  = opt.design->padding[BTOP] + opt.design->padding[BBOT];
-        if (pad > 0) {
-            pad += input.anz_lines;
-            pad += opt.design->shape[NW].height + opt.design->shape[SW].height;
-            if (pad > opt.design->minheight) {
-                if (opt.reqheight) {
-                    for (i=0; i<(int)(pad-opt.design->minheight); ++i) {
-                        if (opt.design->padding[i%2?BBOT:BTOP])
-                            opt.design->padding[i%2?BBOT:BTOP] -= 1;
-                        else if (opt.design->padding[i%2?BTOP:BBOT])
-                            opt.design->padding[i%2?BTOP:BBOT] -= 1;
-                        else
-                            break;
-                    }
-                }
-                else {
-                    opt.design->minheight = pad;
-                }
-            }
-        }
-        pad = opt.design->padding[BLEF] + opt.design->padding[BRIG];
-        if (pad > 0) {
-            pad += input.maxline;
-            pad += opt.design->shape[NW].width + opt.design->shape[NE].width;
-            if (pad > opt.design->minwidth) {
-                if (opt.reqwidth) {
-                    for (i=0; i<(int)(pad-opt.design->minwidth); ++i) {
-                        if (opt.design->padding[i%2?BRIG:BLEF])
-                            opt.design->padding[i%2?BRIG:BLEF] -= 1;
-                        else if (opt.design->padding[i%2?BLEF:BRIG])
-                            opt.design->padding[i%2?BLEF:BRIG] -= 1;
-                        else
-                            break;
-                    }
-                }
-                else {
-                    opt.design->minwidth = pad;
-                }
-            }
-        }
-
-        if (opt.r) {
-            /*
-             *  Remove box
-             */
-            #ifdef DEBUG
-                fprintf (stderr, "Removing Box ...\n");
-            #endif
-            if (opt.killblank == -1) {
-                if (empty_side (opt.design->shape, BTOP)
-                        && empty_side (opt.design->shape, BBOT))
-                    opt.killblank = 0;
-                else
-                    opt.killblank = 1;
-            }
-            rc = remove_box();
-            if (rc)
-                exit (EXIT_FAILURE);
-            rc = apply_substitutions (1);
-            if (rc)
-                exit (EXIT_FAILURE);
-            output_input (opt.mend > 0);
-        }
+        rc = stream_input();
+        exit (rc? EXIT_FAILURE: EXIT_SUCCESS);
+    }
 
-        else {
-            /*
-             *  Generate box
-             */
-            sentry_t *thebox;
+    /*
+     *  In batch mode, process all files given on the command line.
+     */
+    if (opt.jobs) {
+        #ifdef DEBUG
+            fprintf (stderr, "Processing %d files in batch mode ...\n",
+                    opt.anz_files);
+        #endif
+        rc = batch_process (process_input);
+        exit (rc? EXIT_FAILURE: EXIT_SUCCESS);
+    }
 
-            #ifdef DEBUG
-                fprintf (stderr, "Generating Box ...\n");
-            #endif
-            thebox = (sentry_t *) calloc (ANZ_SIDES, sizeof(sentry_t));
-            if (thebox == NULL) {
-                perror (PROJECT);
-                exit (EXIT_FAILURE);
-            }
-            rc = generate_box (thebox);
-            if (rc)
-                exit (EXIT_FAILURE);
-            output_box (thebox);
-        }
-    } while (opt.mend > 0);
+    rc = process_input();
+    if (rc)
+        exit (EXIT_FAILURE);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,43 @@
+/*
+ *  File:             builtin.h
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 15:23h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Box designs compiled into the program
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *  The definitions are in builtin.c, which is generated from the default
+ *  config file by mkbuiltin at build time.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#ifndef BUILTIN_H
+#define BUILTIN_H
+
+
+#define BUILTIN_CONFIG "(built-in)"      /* yyfilename of built-in designs */
+
+extern design_t  builtin_designs[];      /* in config file order */
+extern const int anz_builtin_designs;
+extern const unsigned long builtin_size;   /* of the config file */
+extern const unsigned long builtin_hash;   /* FNV-1a of the config file */
+
+
+#endif /*BUILTIN_H*/
+
+/*EOF*/                                          /* vim: set cindent sw=4: */
@@ -45,6 +45,63 @@
 #endif
 
 
+/*
+ *  Batch mode (-j) processes several files at once using POSIX threads.
+ *  Data which must be private to each thread is declared THREAD_LOCAL.
+ *  Without thread support, batch mode processes the files one by one.
+ */
+#if !defined(_WIN32)
+#define HAVE_PTHREAD
+#endif
+
+#if defined(HAVE_PTHREAD) && defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#undef HAVE_PTHREAD
+#define THREAD_LOCAL
+#endif
+
+
+/*
+ *  Config files which are regular files are mapped into memory and scanned
+ *  in place, instead of being read through stdio.
+ */
+#if !defined(_WIN32)
+#define HAVE_MMAP
+#endif
+
+
+/*
+ *  Server mode (-w) and its clients communicate over a Unix domain socket.
+ */
+#if !defined(_WIN32)
+#define HAVE_UNIX_SOCKETS
+#endif
+
+/*
+ *  In server mode, the config file is read again when it changes. Changes
+ *  are noticed via inotify by a thread of their own.
+ */
+#if defined(__linux__) && defined(HAVE_PTHREAD)
+#define HAVE_INOTIFY
+#endif
+
+/*
+ *  Parsed designs can be shared between processes in POSIX shared memory
+ *  (see shmdesigns.c).
+ */
+#if !defined(_WIN32)
+#define HAVE_SHM_OPEN
+#endif
+
+/*
+ *  struct stat has the modification time to the nanosecond (st_mtim).
+ */
+#if defined(__linux__) || defined(__GLIBC__) || defined(__FreeBSD__)
+#define HAVE_ST_MTIM
+#endif
+
+
 #endif /*CONFIG_H*/
 
 
@@ -0,0 +1,300 @@
+/*
+ *  File:             detcache.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 14:58h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Persistent cache of design autodetection results
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *  The cache file is named by the BOXES_CACHE environment variable. If it
+ *  is not set, no cache is used. Each line of the file holds a key and the
+ *  name of the design which was detected for it. The key is a hash of the
+ *  first and last line of the box, with surrounding whitespace removed,
+ *  and of the identity of the config file, or of the built-in designs,
+ *  which have no file (see cache_set_identity()). The most recently stored entry
+ *  comes first, and the oldest entries are dropped when the file is full.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "detcache.h"
+
+
+
+#define CACHE_ENTRIES 64                 /* max. number of entries in file */
+#define CACHE_LINE    (LINE_MAX+32)      /* max. length of a cache file line */
+
+
+static const char *config_ident = NULL;  /* identifies designs without file */
+
+
+
+static unsigned long hash_bytes (unsigned long h, const char *p, size_t len)
+/*
+ *  Continue the FNV-1a hash h over len bytes at p.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    while (len-- > 0) {
+        h ^= (unsigned char) *p++;
+        h = (h * 16777619UL) & 0xffffffffUL;
+    }
+    return h;
+}
+
+
+
+static unsigned long hash_trimmed (unsigned long h, const line_t *line)
+/*
+ *  Continue the hash h over the text of line, without leading and trailing
+ *  whitespace. The line is terminated in the hash, so that two lines hash
+ *  differently from their concatenation.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t start = 0;
+    size_t end = line->len;
+
+    while (start < end && (line->text[start] == ' ' || line->text[start] == '\t'))
+        ++start;
+    while (end > start && (line->text[end-1] == ' ' || line->text[end-1] == '\t'))
+        --end;
+
+    return hash_bytes (hash_bytes (h, line->text + start, end - start), "\n", 1);
+}
+
+
+
+static int cache_key (unsigned long *key)
+/*
+ *  Compute the cache key for the box in input.
+ *
+ *    key   RESULT: the key
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   no key (no input, or config file cannot be identified)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    struct stat   st;
+    unsigned long h = 2166136261UL;
+    char          ident[64];
+
+    if (input.anz_lines == 0)
+        return 1;
+    if (config_ident) {
+        h = hash_bytes (h, config_ident, strlen (config_ident) + 1);
+    }
+    else {
+        if (yyfilename == NULL || stat (yyfilename, &st))
+            return 1;
+        sprintf (ident, "%lu %lu %lu\n", (unsigned long) st.st_size,
+                (unsigned long) st.st_mtime, (unsigned long) st.st_ino);
+        h = hash_bytes (h, yyfilename, strlen (yyfilename) + 1);
+        h = hash_bytes (h, ident, strlen (ident));
+    }
+    h = hash_trimmed (h, input.lines);
+    h = hash_trimmed (h, input.lines + input.anz_lines - 1);
+
+    *key = h;
+    return 0;
+}
+
+
+
+int cache_enabled()
+/*
+ *  RETURNS:  != 0   the autodetection cache is used (BOXES_CACHE is set)
+ *            == 0   there is no cache
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const char *path = getenv ("BOXES_CACHE");
+
+    return path != NULL && *path != '\0';
+}
+
+
+
+void cache_set_identity (const char *ident)
+/*
+ *  Identify the designs in use by ident instead of by their config file.
+ *  This is needed for designs which were not read from a file, such as the
+ *  built-in designs. ident must remain valid, and should change whenever
+ *  the designs do. NULL reverts to identifying the config file.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    config_ident = ident;
+}
+
+
+
+static char *parse_entry (char *buf, unsigned long *key)
+/*
+ *  Split a line of the cache file into its key and design name. The line
+ *  break is removed from buf.
+ *
+ *  RETURNS:  the design name (points into buf), or NULL if malformed
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char  *p;
+    size_t len = strlen (buf);
+
+    if (len > 0 && buf[len-1] == '\n')
+        buf[--len] = '\0';
+    *key = strtoul (buf, &p, 16);
+    if (p == buf || *p != ' ' || p[1] == '\0')
+        return NULL;
+    return p + 1;
+}
+
+
+
+design_t *cache_lookup()
+/*
+ *  Look up the design of the box in input in the cache file.
+ *
+ *  The entry found is not verified here, so the caller must check that the
+ *  design fits the box.
+ *
+ *  RETURNS:  != NULL   the design stored for the box
+ *            == NULL   no cache, not found, or design no longer exists
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char          *path = getenv ("BOXES_CACHE");
+    FILE          *f;
+    char           buf[CACHE_LINE];
+    unsigned long  key, k;
+    char          *name = NULL;
+    design_t      *res = NULL;
+    int            i;
+
+    if (path == NULL || *path == '\0' || cache_key (&key))
+        return NULL;
+    f = fopen (path, "r");
+    if (f == NULL)
+        return NULL;
+
+    while (fgets (buf, CACHE_LINE, f)) {
+        name = parse_entry (buf, &k);
+        if (name != NULL && k == key)
+            break;
+        name = NULL;
+    }
+    fclose (f);
+
+    if (name != NULL) {
+        for (i=0; i<anz_designs; ++i) {
+            if (strcmp (name, designs[i].name) == 0) {
+                res = designs + i;
+                break;
+            }
+        }
+    }
+
+    #ifdef DEBUG
+        fprintf (stderr, "Autodetection cache: key %08lx, %s\n", key,
+                res? res->name: "not found");
+    #endif
+    return res;
+}
+
+
+
+void cache_store (const design_t *d)
+/*
+ *  Store d as the design of the box in input in the cache file. The new
+ *  entry replaces any previous one for the same key. The file is replaced
+ *  as a whole, so concurrent readers always see a complete file.
+ *
+ *  Errors are ignored, as the cache is only an optimization.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char          *path = getenv ("BOXES_CACHE");
+    char          *tmpname;
+    FILE          *f;
+    FILE          *out;
+    int            fd;
+    char           buf[CACHE_LINE];
+    unsigned long  key, k;
+    int            anz = 1;
+
+    if (path == NULL || *path == '\0' || cache_key (&key))
+        return;
+    if (strlen (d->name) > LINE_MAX)
+        return;
+
+    tmpname = (char *) malloc (strlen (path) + 8);
+    if (tmpname == NULL)
+        return;
+    sprintf (tmpname, "%s.XXXXXX", path);
+    fd = mkstemp (tmpname);
+    if (fd == -1) {
+        BFREE (tmpname);
+        return;
+    }
+    out = fdopen (fd, "w");
+    if (out == NULL) {
+        close (fd);
+        unlink (tmpname);
+        BFREE (tmpname);
+        return;
+    }
+
+    fprintf (out, "%08lx %s\n", key, d->name);
+    f = fopen (path, "r");
+    if (f != NULL) {
+        while (anz < CACHE_ENTRIES && fgets (buf, CACHE_LINE, f)) {
+            char *name = parse_entry (buf, &k);
+            if (name == NULL || k == key)
+                continue;
+            fprintf (out, "%08lx %s\n", k, name);
+            ++anz;
+        }
+        fclose (f);
+    }
+
+    if (fclose (out) || rename (tmpname, path))
+        unlink (tmpname);
+    BFREE (tmpname);
+}
+
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
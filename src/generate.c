@@ -31,6 +31,7 @@
 #include "boxes.h"
 #include "tools.h"
 #include "generate.h"
+#include "spool.h"
 
 
 static const char rcsid_generate_c[] =
@@ -499,6 +500,64 @@ static void horiz_assemble (const sentry_t *sarr, const shape_t *seite,
 
 
 
+static THREAD_LOCAL size_t lazy_iltf[ANZ_SIDES][SHAPES_PER_SIDE-2];  /* for vert_side_line() */
+
+static const char *vert_side_line (const sentry_t *sarr, const sentry_t *thebox,
+        const int aside, const size_t j)
+/*
+ *  Return line j of the left or right box side.
+ *
+ *    sarr    Array of shapes from the current design
+ *    thebox  the previously generated box parts
+ *    aside   BLEF or BRIG
+ *    j       line of the box side to return
+ *
+ *  Usually, this is just the line stored by horiz_assemble(). For spooled
+ *  input, the box sides are not stored in order to keep the memory needed
+ *  independent of the number of input lines. In that case, the line is
+ *  computed from the individual lines to fill by the side shapes, in the
+ *  same way that horiz_assemble() does it.
+ *
+ *  RETURNS:  the line (not a copy)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const shape_t *seite = (aside == BLEF)? west_side : east_side;
+    shape_t ctop, cbottom;
+    size_t  k;
+    int     i, cshape;
+
+    if (thebox[aside].chars != NULL)
+        return thebox[aside].chars[j];
+
+    if (aside == BRIG) {
+        ctop = seite[0];
+        cbottom = seite[SHAPES_PER_SIDE-1];
+    }
+    else {
+        ctop = seite[SHAPES_PER_SIDE-1];
+        cbottom = seite[0];
+    }
+
+    if (j < sarr[ctop].height)
+        return sarr[ctop].chars[j];
+    if (j >= thebox[aside].height - sarr[cbottom].height)
+        return sarr[cbottom].chars[j - (thebox[aside].height - sarr[cbottom].height)];
+
+    k = j - sarr[ctop].height;
+    for (i=0; i<SHAPES_PER_SIDE-2; ++i) {
+        cshape = (aside == BRIG)? i : SHAPES_PER_SIDE-3-i;
+        if (k < lazy_iltf[aside][cshape])
+            return sarr[seite[cshape+1]].chars[k % sarr[seite[cshape+1]].height];
+        k -= lazy_iltf[aside][cshape];
+    }
+
+    return "";                           /* must never happen */
+}
+
+
+
 static int horiz_generate (sentry_t *tresult, sentry_t *bresult)
 /*
  *  Generate top and bottom parts of box (excluding corners).
@@ -513,10 +572,8 @@ static int horiz_generate (sentry_t *tresult, sentry_t *bresult)
     size_t tiltf[SHAPES_PER_SIDE-2];     /* individual lines to fill (top) */
     int    rc;                           /* received return code */
 
-    tresult->height = highest (opt.design->shape,
-            SHAPES_PER_SIDE, NW, NNW, N, NNE, NE);
-    bresult->height = highest (opt.design->shape,
-            SHAPES_PER_SIDE, SW, SSW, S, SSE, SE);
+    tresult->height = opt.design->metrics.height[BTOP];
+    bresult->height = opt.design->metrics.height[BBOT];
 
     rc = horiz_precalc (opt.design->shape, tiltf, biltf, &(tresult->width));
     if (rc) return rc;
@@ -585,10 +642,8 @@ static int vert_generate (sentry_t *lresult, sentry_t *rresult)
     size_t rightiltf[SHAPES_PER_SIDE-2]; /* individual lines to fill */
     int    rc;                           /* received return code */
 
-    lresult->width = widest (opt.design->shape,
-            SHAPES_PER_SIDE, SW, WSW, W, WNW, NW);
-    rresult->width = widest (opt.design->shape,
-            SHAPES_PER_SIDE, SE, ESE, E, ENE, NE);
+    lresult->width = opt.design->metrics.width[BLEF];
+    rresult->width = opt.design->metrics.width[BRIG];
 
     rc = vert_precalc (opt.design->shape, leftiltf, rightiltf, &vspace);
     if (rc) return rc;
@@ -613,6 +668,17 @@ static int vert_generate (sentry_t *lresult, sentry_t *rresult)
                 shape_name[east_side[3]], rightiltf[2]);
     #endif
 
+    if (input.spooled) {
+        /*
+         *  Box sides are computed line by line upon output (vert_side_line())
+         */
+        memcpy (lazy_iltf[BLEF], leftiltf, sizeof(leftiltf));
+        memcpy (lazy_iltf[BRIG], rightiltf, sizeof(rightiltf));
+        lresult->chars = NULL;
+        rresult->chars = NULL;
+        return 0;
+    }
+
     lresult->chars = (char **) calloc (lresult->height, sizeof(char *));
     if (lresult->chars == NULL) return 1;
     rresult->chars = (char **) calloc (rresult->height, sizeof(char *));
@@ -677,6 +743,25 @@ err:
 
 
 
+void free_box (sentry_t *thebox)
+/*
+ *  Free the memory allocated by generate_box(). The top and bottom sides
+ *  own their lines, while the lines of the left and right sides point into
+ *  the shapes of the design.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    freeshape (thebox + BTOP);
+    freeshape (thebox + BBOT);
+    BFREE (thebox[BLEF].chars);
+    BFREE (thebox[BRIG].chars);
+    thebox[BLEF] = SENTRY_INITIALIZER;
+    thebox[BRIG] = SENTRY_INITIALIZER;
+}
+
+
+
 static int justify_line (line_t *line, int skew)
 /*
  *  Justify input line according to specified justification
@@ -805,12 +890,123 @@ static int justify_line (line_t *line, int skew)
 
 
 
-int output_box (const sentry_t *thebox)
+static THREAD_LOCAL line_t spool_window;          /* current line if input is spooled */
+static THREAD_LOCAL size_t spool_window_idx = 0;  /* index of line in spool_window */
+
+static line_t *text_line (const size_t ti)
 /*
- *  Generate final output using the previously generated box parts.
+ *  Return line number ti of the input text.
  *
- *    thebox    Array of four shapes which contain the previously generated
- *              box parts in the following order: BTOP, BRIG, BBOT, BLEF
+ *  If the input has been spooled, lines are read from the spool file on
+ *  demand. In this case, lines must be requested in ascending order, and
+ *  only the current line is valid at any time.
+ *
+ *  RETURNS:  pointer to the line
+ *            NULL if the line does not exist or could not be read
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (ti >= input.anz_lines)
+        return NULL;
+    if (!input.spooled)
+        return input.lines + ti;
+
+    while (spool_window.text == NULL || spool_window_idx < ti) {
+        if (spool_window.text != NULL) {
+            BFREE (spool_window.text);
+            BFREE (spool_window.tabpos);
+            ++spool_window_idx;
+        }
+        if (spool_read (&spool_window))
+            return NULL;
+    }
+    if (spool_window_idx != ti) {
+        fprintf (stderr, "%s: internal error\n", PROJECT);
+        return NULL;
+    }
+    return &spool_window;
+}
+
+
+
+static int append_line (input_t *result, const char *text, const size_t len,
+        const line_t *tline, const int keep_tabs)
+/*
+ *  Append a line of the box to result, where it becomes input text for
+ *  drawing an outer box (-d a,b).
+ *
+ *    result     the line array to add to
+ *    text       the line of the box, len characters long
+ *    tline      the line of text the box line belongs to (may be NULL)
+ *    keep_tabs  true if tabs in the indentation of the text are kept (-t k),
+ *               so their positions are taken over from tline
+ *
+ *  RETURNS:  == 0  if successful
+ *            != 0  on error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    line_t *line;
+    size_t  i;
+
+    if (result->anz_lines == result->alloc_lines) {
+        size_t  n = result->alloc_lines? 2*result->alloc_lines: 100;
+        line_t *tmp = (line_t *) realloc (result->lines, n*sizeof(line_t));
+        if (tmp == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        result->lines = tmp;
+        result->alloc_lines = n;
+    }
+
+    line = result->lines + result->anz_lines;
+    memset (line, 0, sizeof(line_t));
+    line->text = (char *) malloc (len + 1);
+    if (line->text == NULL) {
+        perror (PROJECT);
+        return 1;
+    }
+    memcpy (line->text, text, len);
+    line->text[len] = '\0';
+    line->len = len;
+    ++(result->anz_lines);
+    if (len > result->maxline)
+        result->maxline = len;
+
+    if (keep_tabs && tline != NULL) {
+        while (line->tabpos_len < tline->tabpos_len
+                && tline->tabpos[line->tabpos_len] < input.indent)
+            ++(line->tabpos_len);
+        if (line->tabpos_len > 0) {
+            line->tabpos = (size_t *) malloc (line->tabpos_len * sizeof(size_t));
+            if (line->tabpos == NULL) {
+                perror (PROJECT);
+                return 1;
+            }
+            for (i=0; i<line->tabpos_len; ++i)
+                line->tabpos[i] = tline->tabpos[i];
+        }
+    }
+
+    return 0;
+}
+
+
+
+static int build_box (const sentry_t *thebox, input_t *result,
+        const int keep_tabs)
+/*
+ *  Put together the lines of the box from the previously generated box
+ *  parts and the input text.
+ *
+ *    thebox     Array of four shapes which contain the previously generated
+ *               box parts in the following order: BTOP, BRIG, BBOT, BLEF
+ *    result     line array to which the lines are appended, or NULL if the
+ *               lines are to be output
+ *    keep_tabs  passed on to append_line()
  *
  *  RETURNS:  == 0  if successful
  *            != 0  on error
@@ -836,6 +1032,9 @@ int output_box (const sentry_t *thebox)
     size_t skip_left;                    /* true if left box part is to be skipped */
     int    ntabs, nspcs;                 /* needed for unexpand of tabs */
     char  *restored_indent;
+    line_t *tline;                       /* current line of text */
+    const char *lside, *rside;           /* current line of box sides */
+    const line_t *src;                   /* line of text for indentation */
 
     #ifdef DEBUG
         fprintf (stderr, "Padding used: left %d, top %d, right %d, bottom %d\n",
@@ -968,11 +1167,11 @@ int output_box (const sentry_t *thebox)
     skip_start = 0;
     skip_end   = 0;
     skip_left  = 0;
-    if (empty_side (opt.design->shape, BTOP))
+    if (opt.design->metrics.empty[BTOP])
         skip_start = opt.design->shape[NW].height;
-    if (empty_side (opt.design->shape, BBOT))
+    if (opt.design->metrics.empty[BBOT])
         skip_end = opt.design->shape[SW].height;
-    if (empty_side (opt.design->shape, BLEF))
+    if (opt.design->metrics.empty[BLEF])
         skip_left = opt.design->shape[NW].width; /* could simply be 1, though */
     #if defined(DEBUG)
         fprintf (stderr, "skip_start = %d;  skip_end = %d;  skip_left = %d;  "
@@ -984,20 +1183,23 @@ int output_box (const sentry_t *thebox)
      */
     for (j=skip_start; j<nol-skip_end; ++j) {
 
+        lside = skip_left? "": vert_side_line (opt.design->shape, thebox, BLEF, j);
+        rside = vert_side_line (opt.design->shape, thebox, BRIG, j);
+
         if (j < thebox[BTOP].height) {   /* box top */
-            restored_indent = tabbify_indent (0, indentspc, indentspclen);
+            src = text_line (0);
+            restored_indent = tabbify_indent (src, indentspc, indentspclen);
             concat_strings (obuf, LINE_MAX+1, 4, restored_indent,
-                    skip_left?"":thebox[BLEF].chars[j], thebox[BTOP].chars[j],
-                    thebox[BRIG].chars[j]);
+                    lside, thebox[BTOP].chars[j], rside);
         }
 
         else if (vfill1) {               /* top vfill */
             r = thebox[BTOP].width;
             trailspc[r] = '\0';
-            restored_indent = tabbify_indent (0, indentspc, indentspclen);
+            src = text_line (0);
+            restored_indent = tabbify_indent (src, indentspc, indentspclen);
             concat_strings (obuf, LINE_MAX+1, 4, restored_indent,
-                    skip_left?"":thebox[BLEF].chars[j], trailspc,
-                    thebox[BRIG].chars[j]);
+                    lside, trailspc, rside);
             trailspc[r] = ' ';
             --vfill1;
         }
@@ -1005,45 +1207,46 @@ int output_box (const sentry_t *thebox)
         else if (j < nol-thebox[BBOT].height) {
             long ti = j - thebox[BTOP].height - (vfill-vfill2);
             if (ti < (long) input.anz_lines) {      /* box content (lines) */
+                tline = text_line (ti);
+                if (tline == NULL)
+                    return 1;
+                src = tline;
                 #if defined(DEBUG) && 0
                     fprintf (stderr, "justify_line ({\"%s\",%d}, %d);\n",
-                            input.lines[ti].text, input.lines[ti].len, hpr-hpl);
+                            tline->text, tline->len, hpr-hpl);
                 #endif
-                rc = justify_line (input.lines+ti, hpr-hpl);
+                rc = justify_line (tline, hpr-hpl);
                 if (rc)
                     return rc;
-                r = input.maxline - input.lines[ti].len;
+                r = input.maxline - tline->len;
                 trailspc[r] = '\0';
-                restored_indent = tabbify_indent (ti, indentspc, indentspclen);
+                restored_indent = tabbify_indent (tline, indentspc, indentspclen);
                 concat_strings (obuf, LINE_MAX+1, 7, restored_indent,
-                        skip_left?"":thebox[BLEF].chars[j], hfill1,
-                        ti >= 0? input.lines[ti].text : "", hfill2,
-                        trailspc, thebox[BRIG].chars[j]);
+                        lside, hfill1, tline->text, hfill2, trailspc, rside);
             }
             else {                       /* bottom vfill */
                 r = thebox[BTOP].width;
                 trailspc[r] = '\0';
-                restored_indent = tabbify_indent (input.anz_lines - 1, indentspc, indentspclen);
+                src = text_line (input.anz_lines - 1);
+                restored_indent = tabbify_indent (src, indentspc, indentspclen);
                 concat_strings (obuf, LINE_MAX+1, 4, restored_indent,
-                        skip_left?"":thebox[BLEF].chars[j], trailspc,
-                        thebox[BRIG].chars[j]);
+                        lside, trailspc, rside);
             }
             trailspc[r] = ' ';
         }
 
         else {                           /* box bottom */
-            restored_indent = tabbify_indent (input.anz_lines - 1, indentspc, indentspclen);
-            concat_strings (obuf, LINE_MAX+1, 4, restored_indent,
-                    skip_left?"":thebox[BLEF].chars[j],
-                    thebox[BBOT].chars[j-(nol-thebox[BBOT].height)],
-                    thebox[BRIG].chars[j]);
+            src = text_line (input.anz_lines - 1);
+            restored_indent = tabbify_indent (src, indentspc, indentspclen);
+            concat_strings (obuf, LINE_MAX+1, 4, restored_indent, lside,
+                    thebox[BBOT].chars[j-(nol-thebox[BBOT].height)], rside);
         }
 
         obuf_len = strlen (obuf);
 
         if (obuf_len > LINE_MAX) {
-            size_t newlen = LINE_MAX;
-            btrim (obuf, &newlen);
+            obuf_len = LINE_MAX;
+            btrim (obuf, &obuf_len);
         }
         else {
             btrim (obuf, &obuf_len);
@@ -1052,9 +1255,15 @@ int output_box (const sentry_t *thebox)
             BFREE (restored_indent);
         }
 
-        fprintf (opt.outfile, "%s\n", obuf);
+        if (result == NULL)
+            fprintf (opt.outfile, "%s\n", obuf);
+        else if (append_line (result, obuf, obuf_len, src, keep_tabs))
+            return 1;
     }
 
+    BFREE (spool_window.text);
+    BFREE (spool_window.tabpos);
+    spool_window_idx = 0;
     BFREE (indentspc);
     BFREE (hfill1);
     BFREE (hfill2);
@@ -1063,4 +1272,189 @@ int output_box (const sentry_t *thebox)
 
 
 
+int output_box (const sentry_t *thebox)
+/*
+ *  Generate final output using the previously generated box parts.
+ *
+ *    thebox    Array of four shapes which contain the previously generated
+ *              box parts in the following order: BTOP, BRIG, BBOT, BLEF
+ *
+ *  RETURNS:  == 0  if successful
+ *            != 0  on error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    return build_box (thebox, NULL, 0);
+}
+
+
+
+int render_box (const sentry_t *thebox, input_t *result)
+/*
+ *  Like output_box(), but append the lines of the box to result instead of
+ *  writing them, so they can be boxed again (-d a,b). The indentation is
+ *  made of spaces only, as if the lines had been read and their tabs
+ *  expanded.
+ *
+ *  RETURNS:  == 0  if successful
+ *            != 0  on error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char tabexp = opt.tabexp;
+    int  rc;
+
+    opt.tabexp = 'e';
+    rc = build_box (thebox, result, tabexp == 'k');
+    opt.tabexp = tabexp;
+    return rc;
+}
+
+
+
+static THREAD_LOCAL size_t stream_row = 0;            /* next line of streamed box, 0 = none open */
+
+static void output_stream_rows (const sentry_t *thebox, const size_t upto)
+/*
+ *  Output the lines of a streamed box which do not contain text, i.e. box
+ *  top, box bottom, or empty lines in between, up to (excluding) line upto.
+ *
+ *    thebox    the previously generated box parts
+ *    upto      index of first box line not to output
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t nol = thebox[BRIG].height;    /* number of output lines */
+    int    skip_left = opt.design->metrics.empty[BLEF];
+    char   obuf[LINE_MAX+1];             /* final output buffer */
+    size_t obuf_len;                     /* length of content of obuf */
+    char   trailspc[LINE_MAX+1];
+
+    memset (trailspc, (int)' ', LINE_MAX);
+    trailspc[thebox[BTOP].width < LINE_MAX? thebox[BTOP].width: LINE_MAX] = '\0';
+
+    for (; stream_row < upto; ++stream_row) {
+        if (stream_row < thebox[BTOP].height) {              /* box top */
+            concat_strings (obuf, LINE_MAX+1, 3,
+                    skip_left?"":thebox[BLEF].chars[stream_row],
+                    thebox[BTOP].chars[stream_row], thebox[BRIG].chars[stream_row]);
+        }
+        else if (stream_row < nol - thebox[BBOT].height) {   /* vfill */
+            concat_strings (obuf, LINE_MAX+1, 3,
+                    skip_left?"":thebox[BLEF].chars[stream_row],
+                    trailspc, thebox[BRIG].chars[stream_row]);
+        }
+        else {                                               /* box bottom */
+            concat_strings (obuf, LINE_MAX+1, 3,
+                    skip_left?"":thebox[BLEF].chars[stream_row],
+                    thebox[BBOT].chars[stream_row-(nol-thebox[BBOT].height)],
+                    thebox[BRIG].chars[stream_row]);
+        }
+        obuf_len = strlen (obuf);
+        btrim (obuf, &obuf_len);
+        fprintf (opt.outfile, "%s\n", obuf);
+    }
+}
+
+
+
+int output_box_line (const sentry_t *thebox, const line_t *line)
+/*
+ *  Output one line of text inside a box of fixed size (streaming mode, -u).
+ *
+ *    thebox    Array of four shapes which contain the previously generated
+ *              box parts in the following order: BTOP, BRIG, BBOT, BLEF
+ *    line      next line of text, or NULL to close the box after the last
+ *              line of text has been output
+ *
+ *  The box top is output along with the first line of text. When the box is
+ *  full, it is closed, and a new box of the same size is started for the
+ *  next line. Text is always positioned at the top left; lines too long for
+ *  the box push out its right side.
+ *
+ *  RETURNS:  == 0  if successful
+ *            != 0  on error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t nol = thebox[BRIG].height;    /* number of output lines */
+    size_t text_start;                   /* first box line for text */
+    size_t text_end;                     /* first box line after text */
+    size_t skip_start = 0;               /* lines to skip for box top */
+    size_t skip_end = 0;                 /* lines to skip for box bottom */
+    int    skip_left;
+    char   hfill1[LINE_MAX+1];
+    char   trailspc[LINE_MAX+1];
+    char   obuf[LINE_MAX+1];
+    size_t obuf_len;
+    size_t r;
+
+    if (opt.design->metrics.empty[BTOP])
+        skip_start = opt.design->shape[NW].height;
+    if (opt.design->metrics.empty[BBOT])
+        skip_end = opt.design->shape[SW].height;
+    skip_left = opt.design->metrics.empty[BLEF];
+
+    text_start = thebox[BTOP].height + opt.design->padding[BTOP];
+    text_end = nol - thebox[BBOT].height - opt.design->padding[BBOT];
+    if (text_end <= text_start) {
+        fprintf (stderr, "%s: internal error\n", PROJECT);
+        return 1;
+    }
+
+    if (line == NULL) {
+        if (stream_row > 0) {
+            output_stream_rows (thebox, nol - skip_end);
+            stream_row = 0;
+        }
+        fflush (opt.outfile);
+        return 0;
+    }
+
+    if (stream_row >= text_end) {        /* box is full, start a new one */
+        output_stream_rows (thebox, nol - skip_end);
+        stream_row = 0;
+    }
+    if (stream_row == 0) {
+        stream_row = skip_start;
+        output_stream_rows (thebox, text_start);
+    }
+
+    r = BMAX (opt.design->padding[BLEF], 0);
+    if (r > LINE_MAX)
+        r = LINE_MAX;
+    memset (hfill1, (int)' ', r);
+    hfill1[r] = '\0';
+    r = 0;
+    if (thebox[BTOP].width > line->len + opt.design->padding[BLEF])
+        r = thebox[BTOP].width - line->len - opt.design->padding[BLEF];
+    if (r > LINE_MAX)
+        r = LINE_MAX;
+    memset (trailspc, (int)' ', r);
+    trailspc[r] = '\0';
+
+    concat_strings (obuf, LINE_MAX+1, 5,
+            skip_left?"":thebox[BLEF].chars[stream_row], hfill1,
+            line->text, trailspc, thebox[BRIG].chars[stream_row]);
+    obuf_len = strlen (obuf);
+    if (obuf_len > LINE_MAX) {
+        size_t newlen = LINE_MAX;
+        btrim (obuf, &newlen);
+    }
+    else {
+        btrim (obuf, &obuf_len);
+    }
+    fprintf (opt.outfile, "%s\n", obuf);
+    fflush (opt.outfile);
+    ++stream_row;
+
+    return 0;
+}
+
+
+
 /*EOF*/                                                 /* vim: set sw=4: */
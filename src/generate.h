@@ -29,6 +29,9 @@
 
 int generate_box (sentry_t *thebox);
 int output_box (const sentry_t *thebox);
+int render_box (const sentry_t *thebox, input_t *result);
+int output_box_line (const sentry_t *thebox, const line_t *line);
+void free_box (sentry_t *thebox);
 
 
 #endif /*GENERATE_H*/
@@ -40,6 +40,8 @@ void begin_speedmode();
 
 void chg_strdelims (const char asdel, const char asesc);
 
+void lexer_restart (FILE *f);
+
 extern int speeding;
 
 
@@ -0,0 +1,476 @@
+/*
+ *  File:             libboxes.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 14:03h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Library interface for drawing and removing boxes
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *           - The processing code works on the thread-local variables opt,
+ *             designs, anz_designs, and input. Every library call swaps the
+ *             context into these variables, and the caller's values back
+ *             out again when it is done. Thus, the code is shared with the
+ *             boxes program, and contexts in different threads are
+ *             independent of each other.
+ *           - The config parser is not reentrant, so only one config is
+ *             parsed at a time.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "regexp.h"
+#include "lexer.h"
+#include "process.h"
+#include "batch.h"
+#include "libboxes.h"
+
+
+
+
+/*       _\|/_
+         (o o)
+ +----oOO-{_}-OOo------------------------------------------------------------+
+ |                    G l o b a l   V a r i a b l e s                        |
+ +--------------------------------------------------------------------------*/
+
+extern int yyparse();
+
+
+struct boxes_s {
+    opt_t     opt;                       /* options, opt.design is in designs */
+    design_t *designs;                   /* designs of the loaded config */
+    int       anz_designs;               /* number of entries in designs */
+    input_t   input;                     /* input lines, array kept for reuse */
+};
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t parser_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+
+/*       _\|/_
+         (o o)
+ +----oOO-{_}-OOo------------------------------------------------------------+
+ |                           F u n c t i o n s                               |
+ +--------------------------------------------------------------------------*/
+
+
+boxes_t *boxes_new()
+/*
+ *  Create a new library context with default options and no designs.
+ *
+ *  RETURNS:  != NULL   the new context
+ *            == NULL   out of memory
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    boxes_t *ctx;
+    opt_t    saved_opt = opt;
+    input_t  empty_input = INPUT_INITIALIZER;
+
+    ctx = (boxes_t *) calloc (1, sizeof(boxes_t));
+    if (ctx == NULL) {
+        perror (PROJECT);
+        return NULL;
+    }
+    set_default_options();
+    ctx->opt = opt;
+    opt = saved_opt;
+    ctx->input = empty_input;
+
+    return ctx;
+}
+
+
+
+void boxes_free (boxes_t *ctx)
+/*
+ *  Free the given context and everything it holds.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (ctx == NULL)
+        return;
+    free_designs (ctx->designs, ctx->anz_designs);
+    BFREE (ctx->opt.recsep);
+    BFREE (ctx->input.lines);
+    BFREE (ctx);
+}
+
+
+
+static int load_config (boxes_t *ctx, FILE *f, const char *name)
+/*
+ *  Parse all designs from the config file f and make them the designs of
+ *  the context, replacing any designs loaded before. The first design is
+ *  selected.
+ *
+ *    name   file name of the config file, for error messages
+ *
+ *  RETURNS:  BOXES_OK      success
+ *            BOXES_ERROR   config file is invalid
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    opt_t     saved_opt = opt;
+    design_t *saved_designs = designs;
+    int       saved_anz_designs = anz_designs;
+    char     *saved_filename;
+    int       rc;
+
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_lock (&parser_lock);
+    #endif
+    saved_filename = yyfilename;
+
+    opt = ctx->opt;
+    opt.design = NULL;
+    opt.design_choice_by_user = 0;
+    opt.l = 1;                           /* parse all designs */
+    designs = NULL;
+    anz_designs = 0;
+    yyfilename = (char *) name;
+    lexer_restart (f);
+
+    rc = yyparse();
+    if (rc == 0) {
+        free_designs (ctx->designs, ctx->anz_designs);
+        ctx->designs = designs;
+        ctx->anz_designs = anz_designs;
+        ctx->opt.design = designs;
+        ctx->opt.design_choice_by_user = 0;
+    }
+
+    yyfilename = saved_filename;
+    opt = saved_opt;
+    designs = saved_designs;
+    anz_designs = saved_anz_designs;
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_unlock (&parser_lock);
+    #endif
+
+    return rc? BOXES_ERROR: BOXES_OK;
+}
+
+
+
+int boxes_load_config (boxes_t *ctx, const char *path)
+/*
+ *  Load the designs of the config file path into the context.
+ *
+ *  RETURNS:  BOXES_OK      success
+ *            BOXES_ERROR   file not readable or invalid
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    FILE *f;
+    int   rc;
+
+    if (ctx == NULL || path == NULL)
+        return BOXES_ERROR;
+    f = fopen (path, "r");
+    if (f == NULL) {
+        fprintf (stderr, "%s: Couldn\'t open config file \'%s\' for input.\n",
+                PROJECT, path);
+        return BOXES_ERROR;
+    }
+    rc = load_config (ctx, f, path);
+    fclose (f);
+    return rc;
+}
+
+
+
+int boxes_load_config_buffer (boxes_t *ctx, const char *buf, const size_t len)
+/*
+ *  Load the designs from a config held in memory into the context.
+ *
+ *  RETURNS:  BOXES_OK      success
+ *            BOXES_ERROR   config invalid
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    FILE *f;
+    int   rc;
+
+    if (ctx == NULL || buf == NULL || len == 0)
+        return BOXES_ERROR;
+    f = fmemopen ((void *) buf, len, "r");
+    if (f == NULL) {
+        perror (PROJECT);
+        return BOXES_ERROR;
+    }
+    rc = load_config (ctx, f, "(buffer)");
+    fclose (f);
+    return rc;
+}
+
+
+
+int boxes_set_design (boxes_t *ctx, const char *name)
+/*
+ *  Select the design of the given name for drawing boxes. Removing a box
+ *  is then restricted to this design as well, instead of autodetecting it.
+ *
+ *  RETURNS:  BOXES_OK      success
+ *            BOXES_ERROR   no such design
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    if (ctx == NULL || name == NULL)
+        return BOXES_ERROR;
+    for (i=0; i<ctx->anz_designs; ++i) {
+        if (!strcasecmp (name, ctx->designs[i].name)) {
+            ctx->opt.design = ctx->designs + i;
+            ctx->opt.design_choice_by_user = 1;
+            return BOXES_OK;
+        }
+    }
+    fprintf (stderr, "%s: unknown box design -- %s\n", PROJECT, name);
+    return BOXES_ERROR;
+}
+
+
+
+int boxes_set_option (boxes_t *ctx, const char oc, const char *arg)
+/*
+ *  Set an option of the context. The options are the same as those of the
+ *  boxes program, but only those which control how a box is drawn or
+ *  removed are supported: -a, -b, -i, -k, -p, -q, -s, -t, and -z.
+ *
+ *    oc    option character
+ *    arg   option argument, as on the command line
+ *
+ *  RETURNS:  BOXES_OK      success
+ *            BOXES_ERROR   unsupported option or invalid argument
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    opt_t  saved_opt = opt;
+    char  *s;
+    int    rc;
+
+    if (ctx == NULL || arg == NULL)
+        return BOXES_ERROR;
+    if (oc == '\0' || strchr ("abikpqstz", oc) == NULL) {
+        fprintf (stderr, "%s: option not supported by library -- %c\n",
+                PROJECT, oc);
+        return BOXES_ERROR;
+    }
+    s = (char *) strdup (arg);           /* set_option() may modify it */
+    if (s == NULL) {
+        perror (PROJECT);
+        return BOXES_ERROR;
+    }
+
+    opt = ctx->opt;
+    rc = set_option (oc, s);
+    ctx->opt = opt;
+    opt = saved_opt;
+
+    BFREE (s);
+    return rc? BOXES_ERROR: BOXES_OK;
+}
+
+
+
+static int run (boxes_t *ctx, const int mode, const char *text,
+                const size_t len, char *out, size_t *outlen)
+/*
+ *  Draw ('d'), remove ('r'), or mend ('m') the box around text and store
+ *  the result in out.
+ *
+ *    text     input text of len bytes
+ *    out      buffer receiving the result, which is terminated by '\0'
+ *    outlen   in: size of out; out: length of the result, or on
+ *             BOXES_TOOSMALL the size out must have
+ *
+ *  RETURNS:  BOXES_OK        success
+ *            BOXES_TOOSMALL  out too small, nothing stored
+ *            BOXES_ERROR     error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    opt_t     saved_opt;                 /* state of the calling thread */
+    design_t *saved_designs;
+    int       saved_anz_designs;
+    input_t   saved_input;
+    design_t *d;
+    size_t    minwidth;                  /* design values changed by options */
+    size_t    minheight;
+    char      indentmode;
+    FILE     *infile;
+    FILE     *outfile;
+    char     *res = NULL;                /* result buffer */
+    size_t    reslen = 0;                /* length of result */
+    int       rc;
+
+    if (ctx == NULL || (text == NULL && len > 0) || outlen == NULL
+            || (out == NULL && *outlen > 0))
+        return BOXES_ERROR;
+    if (ctx->designs == NULL) {
+        fprintf (stderr, "%s: no designs loaded\n", PROJECT);
+        return BOXES_ERROR;
+    }
+    if (len == 0) {                      /* no input, no output */
+        if (*outlen == 0) {
+            *outlen = 1;
+            return BOXES_TOOSMALL;
+        }
+        out[0] = '\0';
+        *outlen = 0;
+        return BOXES_OK;
+    }
+
+    infile = fmemopen ((void *) text, len, "r");
+    if (infile == NULL) {
+        perror (PROJECT);
+        return BOXES_ERROR;
+    }
+    outfile = open_memstream (&res, &reslen);
+    if (outfile == NULL) {
+        perror (PROJECT);
+        fclose (infile);
+        return BOXES_ERROR;
+    }
+
+    saved_opt = opt;
+    saved_designs = designs;
+    saved_anz_designs = anz_designs;
+    saved_input = input;
+    opt = ctx->opt;
+    designs = ctx->designs;
+    anz_designs = ctx->anz_designs;
+    input = ctx->input;
+
+    opt.infile = infile;
+    opt.outfile = outfile;
+    if (mode == 'r') {
+        opt.r = 1;
+    }
+    else if (mode == 'm') {
+        opt.mend = 1;
+        opt.r = 1;
+        opt.killblank = 0;
+    }
+    d = opt.design;
+    minwidth = d->minwidth;
+    minheight = d->minheight;
+    indentmode = d->indentmode;
+    apply_design_options();
+
+    rc = process_input();
+
+    d->minwidth = minwidth;
+    d->minheight = minheight;
+    d->indentmode = indentmode;
+    ctx->input = input;                  /* line array is reused next time */
+
+    opt = saved_opt;
+    designs = saved_designs;
+    anz_designs = saved_anz_designs;
+    input = saved_input;
+
+    fclose (infile);
+    if (fclose (outfile) && rc == 0) {
+        perror (PROJECT);
+        rc = 1;
+    }
+    if (rc) {
+        BFREE (res);
+        return BOXES_ERROR;
+    }
+
+    if (reslen >= *outlen) {
+        *outlen = reslen + 1;
+        BFREE (res);
+        return BOXES_TOOSMALL;
+    }
+    memcpy (out, res, reslen + 1);
+    *outlen = reslen;
+    BFREE (res);
+
+    return BOXES_OK;
+}
+
+
+
+int boxes_draw (boxes_t *ctx, const char *text, const size_t len,
+                char *out, size_t *outlen)
+/*
+ *  Draw a box around text, using the selected design (or the first design
+ *  of the config if none was selected). See run() for the arguments.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    return run (ctx, 'd', text, len, out, outlen);
+}
+
+
+
+int boxes_remove (boxes_t *ctx, const char *text, const size_t len,
+                  char *out, size_t *outlen)
+/*
+ *  Remove the box from text. Unless a design was selected, the design is
+ *  autodetected. See run() for the arguments.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    return run (ctx, 'r', text, len, out, outlen);
+}
+
+
+
+int boxes_mend (boxes_t *ctx, const char *text, const size_t len,
+                char *out, size_t *outlen)
+/*
+ *  Remove the box from text and draw it again, like "boxes -m".
+ *  See run() for the arguments.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    return run (ctx, 'm', text, len, out, outlen);
+}
+
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
@@ -0,0 +1,68 @@
+/*
+ *  File:             libboxes.h
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 14:03h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Library interface for drawing and removing boxes
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *           - All state of the library is kept in a context (boxes_t), which
+ *             holds the designs, the options, and the input buffers. Any
+ *             number of contexts may be used concurrently, but a single
+ *             context must only be used by one thread at a time.
+ *           - Errors are reported on stderr, as by the boxes program.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#ifndef LIBBOXES_H
+#define LIBBOXES_H
+
+#include <stddef.h>
+
+
+typedef struct boxes_s boxes_t;          /* opaque library context */
+
+
+/*
+ *  Return codes of the library functions
+ */
+#define BOXES_OK        0                /* success */
+#define BOXES_ERROR     1                /* invalid argument, config, or input */
+#define BOXES_TOOSMALL  2                /* output buffer too small */
+
+
+boxes_t *boxes_new();
+void     boxes_free (boxes_t *ctx);
+
+int boxes_load_config (boxes_t *ctx, const char *path);
+int boxes_load_config_buffer (boxes_t *ctx, const char *buf, const size_t len);
+
+int boxes_set_design (boxes_t *ctx, const char *name);
+int boxes_set_option (boxes_t *ctx, const char oc, const char *arg);
+
+int boxes_draw (boxes_t *ctx, const char *text, const size_t len,
+                char *out, size_t *outlen);
+int boxes_remove (boxes_t *ctx, const char *text, const size_t len,
+                  char *out, size_t *outlen);
+int boxes_mend (boxes_t *ctx, const char *text, const size_t len,
+                char *out, size_t *outlen);
+
+
+#endif /*LIBBOXES_H*/
+
+/*EOF*/                                          /* vim: set cindent sw=4: */
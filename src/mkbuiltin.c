@@ -0,0 +1,402 @@
+/*
+ *  File:             mkbuiltin.c
+ *  Project Main:     mkbuiltin.c
+ *  Date created:     October 19, 2026 (Monday, 15:23h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Compile a config file into the built-in design table
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *  This program is run at build time. It parses the config file given on
+ *  its command line and writes C source code to stdout, which defines the
+ *  same designs as static data (see builtin.h). Everything the parser
+ *  computes is written out as well, so the designs can be used without
+ *  any further work. Only the regular expressions of the replacement rules
+ *  are left to be compiled when they are first used, as usual.
+ *
+ *  The size and hash of the config file are written as well. They identify
+ *  the built-in designs, and let boxes recognize an unmodified copy of the
+ *  config file, which need not be parsed.
+ *
+ *  The designs are written as positional initializers, so this file must
+ *  be kept in sync with the definition of design_t in boxes.h.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "process.h"
+
+
+extern FILE *yyin;                       /* lex input file */
+extern int yyparse();
+
+
+
+static void put_string (const char *s)
+/*
+ *  Write s as a C string literal. A string containing line breaks is
+ *  split into one literal per line. NULL is written as NULL.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const unsigned char *p;
+
+    if (s == NULL) {
+        printf ("NULL");
+        return;
+    }
+
+    putchar ('"');
+    for (p = (const unsigned char *) s; *p; ++p) {
+        switch (*p) {
+            case '\\': printf ("\\\\"); break;
+            case '"':  printf ("\\\""); break;
+            case '?':  printf ("\\?");  break;      /* no trigraphs */
+            case '\t': printf ("\\t");  break;
+            case '\n':
+                printf ("\\n");
+                if (p[1])
+                    printf ("\"\n        \"");
+                break;
+            default:
+                if (*p < 32 || *p > 126)
+                    printf ("\\%03o", *p);
+                else
+                    putchar (*p);
+                break;
+        }
+    }
+    putchar ('"');
+}
+
+
+
+static void put_shapes (const int i)
+/*
+ *  Write the lines of the shapes of design i as character arrays, and the
+ *  line pointer arrays which refer to them.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const design_t *d = designs + i;
+    int    j;
+    size_t k;
+
+    for (j=0; j<ANZ_SHAPES; ++j) {
+        if (d->shape[j].chars == NULL)
+            continue;
+        for (k=0; k<d->shape[j].height; ++k) {
+            printf ("static char s%d_%d_%lu[] = ", i, j, (unsigned long) k);
+            put_string (d->shape[j].chars[k]);
+            printf (";\n");
+        }
+        printf ("static char *c%d_%d[] = {", i, j);
+        for (k=0; k<d->shape[j].height; ++k)
+            printf ("%s s%d_%d_%lu", k? ",": "", i, j, (unsigned long) k);
+        printf (" };\n");
+    }
+}
+
+
+
+static void put_rules (const int i, const char *kind,
+                       const reprule_t *rules, const size_t anz)
+/*
+ *  Write the replacement or reversion rules of design i as an array.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t k;
+
+    if (anz == 0)
+        return;
+    printf ("static reprule_t %s%d[] = {\n", kind, i);
+    for (k=0; k<anz; ++k) {
+        printf ("    { ");
+        put_string (rules[k].search);
+        printf (", ");
+        put_string (rules[k].repstr);
+        printf (", NULL, %d, '%c' },\n", rules[k].line, rules[k].mode);
+    }
+    printf ("};\n");
+}
+
+
+
+static int put_trims (const int i, const char *kind,
+                      const trimmed_t *trims, const size_t anz)
+/*
+ *  Write the trimmed shape lines of design i as an array. Each
+ *  variant points into one of the shape lines written by put_shapes().
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   variant not found in any shape line
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const design_t *d = designs + i;
+    size_t k;
+    size_t l;
+    int    j;
+
+    if (anz == 0)
+        return 0;
+    printf ("static trimmed_t %s%d[] = {\n", kind, i);
+    for (k=0; k<anz; ++k) {
+        const char *t = trims[k].text;
+        int found = 0;
+        for (j=0; !found && j<ANZ_SHAPES; ++j) {
+            for (l=0; !found && l<d->shape[j].height; ++l) {
+                const char *s = d->shape[j].chars[l];
+                if (t >= s && t < s + d->shape[j].width) {
+                    printf ("    { s%d_%d_%lu + %lu, %lu, %lu, %lu },\n",
+                            i, j, (unsigned long) l, (unsigned long) (t - s),
+                            (unsigned long) trims[k].len,
+                            (unsigned long) trims[k].lead,
+                            (unsigned long) trims[k].trail);
+                    found = 1;
+                }
+            }
+        }
+        if (!found) {
+            fprintf (stderr, "%s: internal error (trim of design %s)\n",
+                    PROJECT, d->name);
+            return 1;
+        }
+    }
+    printf ("};\n");
+    return 0;
+}
+
+
+
+static size_t anz_corners (const int i)
+{
+    size_t anz = 0;
+    int    c;
+
+    for (c=0; c<ANZ_CORNERS; ++c)
+        anz += designs[i].anz_corner_trims[c];
+    return anz;
+}
+
+
+
+static void put_info (const int i)
+/*
+ *  Write the metadata of design i.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const designinfo_t *info = designs[i].info;
+
+    if (info == NULL)
+        return;
+    printf ("static designinfo_t info%d = {\n    ", i);
+    put_string (info->author);
+    printf (",\n    ");
+    put_string (info->designer);
+    printf (",\n    ");
+    put_string (info->created);
+    printf (",\n    ");
+    put_string (info->revision);
+    printf (",\n    ");
+    put_string (info->revdate);
+    printf (",\n    ");
+    put_string (info->sample);
+    printf ("\n};\n");
+}
+
+
+
+static void put_ints (const int *a, const int n)
+{
+    int j;
+
+    printf ("{");
+    for (j=0; j<n; ++j)
+        printf ("%s%d", j? ", ": "", a[j]);
+    printf ("}");
+}
+
+static void put_sizes (const size_t *a, const int n)
+{
+    int j;
+
+    printf ("{");
+    for (j=0; j<n; ++j)
+        printf ("%s%lu", j? ", ": "", (unsigned long) a[j]);
+    printf ("}");
+}
+
+
+
+static void put_design (const int i)
+/*
+ *  Write the entry of design i in the design table. The arrays it refers
+ *  to must have been written before.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const design_t  *d = designs + i;
+    const metrics_t *m = &(d->metrics);
+    int j, k;
+
+    printf ("    {   ");
+    put_string (d->name);
+    printf (",\n        {\n");
+    for (j=0; j<ANZ_SHAPES; ++j) {
+        printf ("            { ");
+        if (d->shape[j].chars)
+            printf ("c%d_%d", i, j);
+        else
+            printf ("NULL");
+        printf (", %lu, %lu, %d },\n", (unsigned long) d->shape[j].height,
+                (unsigned long) d->shape[j].width, d->shape[j].elastic);
+    }
+    printf ("        },\n");
+    printf ("        %lu, %lu, %lu, ", (unsigned long) d->maxshapeheight,
+            (unsigned long) d->minwidth, (unsigned long) d->minheight);
+    put_ints (d->padding, ANZ_SIDES);
+    printf (", '%c',\n        { ", d->indentmode);
+    put_ints (m->empty, ANZ_SIDES);
+    printf (", ");
+    put_sizes (m->height, ANZ_SIDES);
+    printf (", ");
+    put_sizes (m->width, ANZ_SIDES);
+    printf (", {");
+    for (j=0; j<ANZ_SIDES; ++j) {
+        printf ("%s{", j? ", ": "");
+        for (k=0; k<SHAPES_PER_SIDE-2; ++k)
+            printf ("%s%d", k? ", ": "", (int) m->middle[j][k]);
+        printf ("}");
+    }
+    printf ("}, ");
+    put_ints (m->anz_middle, ANZ_SIDES);
+    printf (" },\n        NULL,\n");
+
+    if (d->anz_reprules)
+        printf ("        rep%d, %lu,\n", i, (unsigned long) d->anz_reprules);
+    else
+        printf ("        NULL, 0,\n");
+    if (d->anz_revrules)
+        printf ("        rev%d, %lu,\n", i, (unsigned long) d->anz_revrules);
+    else
+        printf ("        NULL, 0,\n");
+    if (d->anz_west_trims)
+        printf ("        wt%d, %lu,\n", i, (unsigned long) d->anz_west_trims);
+    else
+        printf ("        NULL, 0,\n");
+    if (d->anz_east_trims)
+        printf ("        et%d, %lu,\n", i, (unsigned long) d->anz_east_trims);
+    else
+        printf ("        NULL, 0,\n");
+    if (anz_corners (i))
+        printf ("        ct%d, ", i);
+    else
+        printf ("        NULL, ");
+    put_sizes (d->anz_corner_trims, ANZ_CORNERS);
+    printf (",\n");
+    if (d->info)
+        printf ("        &info%d\n", i);
+    else
+        printf ("        NULL\n");
+    printf ("    },\n");
+}
+
+
+
+int main (int argc, char *argv[])
+{
+    int i;
+    unsigned long hash;
+    unsigned long size;
+
+    if (argc != 2) {
+        fprintf (stderr, "Usage: mkbuiltin configfile\n");
+        return EXIT_FAILURE;
+    }
+
+    yyin = fopen (argv[1], "r");
+    if (yyin == NULL) {
+        fprintf (stderr, "%s: Couldn\'t open config file \'%s\' for input.\n",
+                PROJECT, argv[1]);
+        return EXIT_FAILURE;
+    }
+    yyfilename = argv[1];
+    set_default_options();
+    opt.l = 1;                           /* parse all designs with metadata */
+    if (yyparse())
+        return EXIT_FAILURE;
+    rewind (yyin);
+    if (hash_file (yyin, &hash, &size)) {
+        perror (PROJECT);
+        return EXIT_FAILURE;
+    }
+    fclose (yyin);
+
+    printf ("/*\n");
+    printf (" *  Built-in box designs, generated by mkbuiltin from %s.\n", argv[1]);
+    printf (" *  DO NOT EDIT.\n");
+    printf (" */\n\n");
+    printf ("#include \"config.h\"\n");
+    printf ("#include <stdlib.h>\n");
+    printf ("#include <stdio.h>\n");
+    printf ("#include \"shape.h\"\n");
+    printf ("#include \"boxes.h\"\n");
+    printf ("#include \"builtin.h\"\n");
+
+    for (i=0; i<anz_designs; ++i) {
+        printf ("\n\n/* %s */\n", designs[i].name);
+        put_shapes (i);
+        put_rules (i, "rep", designs[i].reprules, designs[i].anz_reprules);
+        put_rules (i, "rev", designs[i].revrules, designs[i].anz_revrules);
+        if (put_trims (i, "wt", designs[i].west_trims, designs[i].anz_west_trims)
+         || put_trims (i, "et", designs[i].east_trims, designs[i].anz_east_trims)
+         || put_trims (i, "ct", designs[i].corner_trims, anz_corners (i)))
+            return EXIT_FAILURE;
+        put_info (i);
+    }
+
+    printf ("\n\ndesign_t builtin_designs[] = {\n");
+    for (i=0; i<anz_designs; ++i)
+        put_design (i);
+    printf ("};\n\n");
+    printf ("const int anz_builtin_designs = %d;\n", anz_designs);
+    printf ("const unsigned long builtin_size = %luUL;\n", size);
+    printf ("const unsigned long builtin_hash = 0x%08lxUL;\n", hash);
+
+    if (fflush (stdout) || ferror (stdout)) {
+        perror (PROJECT);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/*EOF*/                                                  /* vim: set sw=4: */
@@ -28,10 +28,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <ctype.h>
 #include "shape.h"
 #include "boxes.h"
 #include "tools.h"
 #include "lexer.h"
+#include "remove.h"
 
 
 const char rcsid_parser_y[] =
@@ -39,6 +41,7 @@ const char rcsid_parser_y[] =
 
 
 static int pflicht = 0;
+static int sample_seen = 0;              /* true if design has a SAMPLE block */
 static int time_for_se_check = 0;
 static int anz_shapespec = 0;            /* number of user-specified shapes */
 
@@ -46,6 +49,11 @@ int speeding = 0;                        /* true if we're skipping designs, */
                                          /* but no error                    */
 static int skipping = 0;                 /* used to limit "skipping" msgs */
 
+static int    anz_alloc = 0;             /* number of entries allocated in designs */
+static int   *name_slots = NULL;         /* hash table of design names, */
+static size_t anz_name_slots = 0;        /* design index + 1 or 0 if free */
+static size_t anz_names = 0;             /* number of used name_slots */
+
 
 
 static int check_sizes()
@@ -261,6 +269,7 @@ static void recover()
  */
 {
      pflicht = 0;
+     sample_seen = 0;
      time_for_se_check = 0;
      anz_shapespec = 0;
      chg_strdelims ('\\', '\"');
@@ -269,18 +278,48 @@ static void recover()
       *  Clear current design
       */
      BFREE (designs[design_idx].name);
-     BFREE (designs[design_idx].author);
-     BFREE (designs[design_idx].designer);
-     BFREE (designs[design_idx].created);
-     BFREE (designs[design_idx].revision);
-     BFREE (designs[design_idx].revdate);
-     BFREE (designs[design_idx].sample);
+     if (designs[design_idx].info) {
+         BFREE (designs[design_idx].info->author);
+         BFREE (designs[design_idx].info->designer);
+         BFREE (designs[design_idx].info->created);
+         BFREE (designs[design_idx].info->revision);
+         BFREE (designs[design_idx].info->revdate);
+         BFREE (designs[design_idx].info->sample);
+         BFREE (designs[design_idx].info);
+     }
+     BFREE (designs[design_idx].west_trims);
+     BFREE (designs[design_idx].east_trims);
+     BFREE (designs[design_idx].corner_trims);
      memset (designs+design_idx, 0, sizeof(design_t));
      designs[design_idx].indentmode = DEF_INDENTMODE;
 }
 
 
 
+static int named_on_cmdline (const char *name)
+/*
+ *  Return true if a design of name name was requested on the command line
+ *  (-d, -x).
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    if (opt.design_choice_by_user && !strcasecmp (name, (char *) opt.design))
+        return 1;
+    if (opt.target && !strcasecmp (name, (char *) opt.target))
+        return 1;
+    for (i=0; i<opt.anz_stack; ++i) {
+        if (!strcasecmp (name, (char *) opt.stack[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+
+
 static int design_needed (const char *name, const int design_idx)
 /*
  *  Return true if design of name name will be needed later on
@@ -288,11 +327,10 @@ static int design_needed (const char *name, const int design_idx)
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    if (opt.design_choice_by_user) {
-        return !strcasecmp (name, (char *) opt.design);
-    }
-    else {
-        if (opt.r || opt.l)
+    if (named_on_cmdline (name))
+        return 1;
+    if (!opt.design_choice_by_user) {
+        if (opt.r || opt.l || opt.server)
             return 1;
         if (design_idx == 0)
             return 1;
@@ -302,6 +340,174 @@ static int design_needed (const char *name, const int design_idx)
 }
 
 
+
+static int keep_metadata()
+/*
+ *  Return true if the design metadata (author, designer, dates, revision,
+ *  and sample) will be needed later on. Only the design listing (-l)
+ *  shows it, so it is not stored for any other purpose.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    return opt.l;
+}
+
+
+
+static designinfo_t *design_info()
+/*
+ *  Return the metadata of the current design, allocating it if necessary.
+ *
+ *  RETURNS:  != NULL   success
+ *            == NULL   out of memory
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (designs[design_idx].info == NULL)
+        designs[design_idx].info = (designinfo_t *) calloc (1, sizeof(designinfo_t));
+    return designs[design_idx].info;
+}
+
+
+
+static size_t name_hash (const char *name)
+/*
+ *  Hash a design name, ignoring case like strcasecmp().
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t h = 5381;
+
+    while (*name)
+        h = h * 33 + (size_t) tolower ((unsigned char) *name++);
+    return h;
+}
+
+
+
+static int find_name (const char *name)
+/*
+ *  Look up a design name among the designs parsed so far.
+ *
+ *  RETURNS:  >= 0   index of the design of that name in designs
+ *             < 0   not found
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t h;
+
+    if (anz_name_slots == 0)
+        return -1;
+    for (h = name_hash (name) & (anz_name_slots-1); name_slots[h];
+            h = (h+1) & (anz_name_slots-1))
+    {
+        if (!strcasecmp (name, designs[name_slots[h]-1].name))
+            return name_slots[h] - 1;
+    }
+    return -1;
+}
+
+
+
+static int remember_name (const int idx)
+/*
+ *  Add the name of design idx to the hash table of design names. The table
+ *  is kept at most half full, doubling its size as needed.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   out of memory
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t h;
+    size_t j;
+
+    if (2 * (anz_names+1) > anz_name_slots) {
+        size_t n = anz_name_slots? 2 * anz_name_slots: 64;
+        int   *tmp = (int *) calloc (n, sizeof(int));
+        if (tmp == NULL)
+            return 1;
+        for (j=0; j<anz_name_slots; ++j) {
+            if (name_slots[j] == 0)
+                continue;
+            for (h = name_hash (designs[name_slots[j]-1].name) & (n-1); tmp[h];
+                    h = (h+1) & (n-1));
+            tmp[h] = name_slots[j];
+        }
+        BFREE (name_slots);
+        name_slots = tmp;
+        anz_name_slots = n;
+    }
+
+    for (h = name_hash (designs[idx].name) & (anz_name_slots-1); name_slots[h];
+            h = (h+1) & (anz_name_slots-1));
+    name_slots[h] = idx + 1;
+    ++anz_names;
+    return 0;
+}
+
+
+
+static void forget_names()
+/*
+ *  Empty the hash table of design names.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    BFREE (name_slots);
+    anz_name_slots = 0;
+    anz_names = 0;
+}
+
+
+
+static int design_parsed (const char *name, const int anz)
+/*
+ *  Return true if a design of name name is among the first anz designs.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i = find_name (name);
+
+    return i >= 0 && i < anz;
+}
+
+
+
+static int all_designs_found (const int anz)
+/*
+ *  Return true if the anz designs parsed so far are all designs which will
+ *  be needed later on, so the rest of the config file can be skipped.
+ *  This must correspond to design_needed().
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    if (!opt.design_choice_by_user)
+        return !opt.r && !opt.l && !opt.server;
+
+    if (!design_parsed ((char *) opt.design, anz))
+        return 0;
+    if (opt.target && !design_parsed ((char *) opt.target, anz))
+        return 0;
+    for (i=0; i<opt.anz_stack; ++i) {
+        if (!design_parsed ((char *) opt.stack[i], anz))
+            return 0;
+    }
+
+    return 1;
+}
+
+
 %}
 
 
@@ -337,8 +543,18 @@ first_rule:
     {
         /*
          *  Initialize parser data structures
+         *  (the parser may be run more than once by the library)
          */
-        designs = (design_t *) calloc (1, sizeof(design_t));
+        pflicht = 0;
+        sample_seen = 0;
+        time_for_se_check = 0;
+        anz_shapespec = 0;
+        speeding = 0;
+        skipping = 0;
+        design_idx = 0;
+        forget_names();
+        anz_alloc = 1;
+        designs = (design_t *) calloc (anz_alloc, sizeof(design_t));
         if (designs == NULL) {
             perror (PROJECT);
             YYABORT;
@@ -352,6 +568,7 @@ config_file
          */
         design_t *tmp;
 
+        forget_names();
         if (design_idx == 0) {
             BFREE (designs);
             anz_designs = 0;
@@ -404,7 +621,6 @@ design: YBOX WORD
 layout YEND WORD
     {
         design_t *tmp;
-        int i;
         char *p;
 
         #ifdef PARSER_DEBUG
@@ -420,11 +636,9 @@ layout YEND WORD
             YYERROR;
         }
 
-        for (i=0; i<design_idx; ++i) {
-            if (strcasecmp ($2, designs[i].name) == 0) {
-                yyerror ("duplicate box design name -- %s", $2);
-                YYERROR;
-            }
+        if (find_name ($2) >= 0) {
+            yyerror ("duplicate box design name -- %s", $2);
+            YYERROR;
         }
 
         p = $2;
@@ -438,33 +652,42 @@ layout YEND WORD
         }
 
         designs[design_idx].name = (char *) strdup ($2);
-        if (designs[design_idx].name == NULL) {
+        if (designs[design_idx].name == NULL || remember_name (design_idx)) {
             perror (PROJECT);
             YYABORT;
         }
+        measure_shapes (designs[design_idx].shape, &(designs[design_idx].metrics));
+        if (build_trims (designs + design_idx))
+            YYABORT;
         pflicht = 0;
+        sample_seen = 0;
         time_for_se_check = 0;
         anz_shapespec = 0;
 
         /*
          *  Check if we need to continue parsing. If not, return.
-         *  The condition here must correspond to design_needed().
          */
-        if (opt.design_choice_by_user || (!opt.r && !opt.l)) {
+        if (all_designs_found (design_idx + 1)) {
             anz_designs = design_idx + 1;
+            forget_names();
             YYACCEPT;
         }
 
         /*
-         *  Allocate space for next design
+         *  Allocate space for next design. The array grows by doubling, so
+         *  that it is not copied over and over again for large config files.
+         *  It is trimmed to its final size when the file has been parsed.
          */
         ++design_idx;
-        tmp = (design_t *) realloc (designs, (design_idx+1)*sizeof(design_t));
-        if (tmp == NULL) {
-            perror (PROJECT);
-            YYABORT;
+        if (design_idx >= anz_alloc) {
+            tmp = (design_t *) realloc (designs, 2*anz_alloc*sizeof(design_t));
+            if (tmp == NULL) {
+                perror (PROJECT);
+                YYABORT;
+            }
+            designs = tmp;
+            anz_alloc *= 2;
         }
-        designs = tmp;
         memset (&(designs[design_idx]), 0, sizeof(design_t));
         designs[design_idx].indentmode = DEF_INDENTMODE;
     }
@@ -476,40 +699,53 @@ layout: layout entry | layout block | entry | block ;
 
 entry: KEYWORD STRING
     {
+        designinfo_t *info = NULL;
+
         #ifdef PARSER_DEBUG
             fprintf (stderr, "entry rule fulfilled [%s = %s]\n", $1, $2);
         #endif
-        if (strcasecmp ($1, "author") == 0) {
-            designs[design_idx].author = (char *) strdup ($2);
-            if (designs[design_idx].author == NULL) {
+        if (strcasecmp ($1, "indent") != 0 && !keep_metadata()) {
+            #ifdef PARSER_DEBUG
+                fprintf (stderr, "%s: Not storing entry [%s].\n", PROJECT, $1);
+            #endif
+            BFREE ($2);
+        }
+        else if (strcasecmp ($1, "indent") != 0
+                && (info = design_info()) == NULL) {
+            perror (PROJECT);
+            YYABORT;
+        }
+        else if (strcasecmp ($1, "author") == 0) {
+            info->author = (char *) strdup ($2);
+            if (info->author == NULL) {
                 perror (PROJECT);
                 YYABORT;
             }
         }
         else if (strcasecmp ($1, "designer") == 0) {
-            designs[design_idx].designer = (char *) strdup ($2);
-            if (designs[design_idx].designer == NULL) {
+            info->designer = (char *) strdup ($2);
+            if (info->designer == NULL) {
                 perror (PROJECT);
                 YYABORT;
             }
         }
         else if (strcasecmp ($1, "revision") == 0) {
-            designs[design_idx].revision = (char *) strdup ($2);
-            if (designs[design_idx].revision == NULL) {
+            info->revision = (char *) strdup ($2);
+            if (info->revision == NULL) {
                 perror (PROJECT);
                 YYABORT;
             }
         }
         else if (strcasecmp ($1, "created") == 0) {
-            designs[design_idx].created = (char *) strdup ($2);
-            if (designs[design_idx].created == NULL) {
+            info->created = (char *) strdup ($2);
+            if (info->created == NULL) {
                 perror (PROJECT);
                 YYABORT;
             }
         }
         else if (strcasecmp ($1, "revdate") == 0) {
-            designs[design_idx].revdate = (char *) strdup ($2);
-            if (designs[design_idx].revdate == NULL) {
+            info->revdate = (char *) strdup ($2);
+            if (info->revdate == NULL) {
                 perror (PROJECT);
                 YYABORT;
             }
@@ -565,24 +801,27 @@ block: YSAMPLE STRING YENDSAMPLE
         /*
          *  SAMPLE block    (STRING is non-empty if we get here)
          */
-        char *line;
-
         #ifdef PARSER_DEBUG
             fprintf (stderr, "SAMPLE block rule satisfied\n");
         #endif
 
-        if (designs[design_idx].sample) {
+        if (sample_seen) {
             yyerror ("duplicate SAMPLE block");
             YYERROR;
         }
-        line = (char *) strdup ($2);
-        if (line == NULL) {
-            perror (PROJECT);
-            YYABORT;
-        }
-
-        designs[design_idx].sample = line;
+        sample_seen = 1;
         ++pflicht;
+
+        if (keep_metadata()) {
+            if (design_info() == NULL) {
+                perror (PROJECT);
+                YYABORT;
+            }
+            designs[design_idx].info->sample = $2;
+        }
+        else {
+            BFREE ($2);
+        }
     }
 
 | YSHAPES  '{' slist  '}'
@@ -0,0 +1,1689 @@
+/*
+ *  File:             process.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 14:03h)
+ *  Author:           Copyright (C) 1999 Thomas Jensen <boxes@thomasjensen.com>
+ *                    Split off from boxes.c by agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Option handling and processing of the input text
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "regexp.h"
+#include "generate.h"
+#include "remove.h"
+#include "spool.h"
+#include "process.h"
+
+
+
+
+/*       _\|/_
+         (o o)
+ +----oOO-{_}-OOo------------------------------------------------------------+
+ |                    G l o b a l   V a r i a b l e s                        |
+ +--------------------------------------------------------------------------*/
+
+char *yyfilename = NULL;                 /* file name of config file used */
+
+THREAD_LOCAL design_t *designs = NULL;   /* available box designs */
+
+THREAD_LOCAL int design_idx = 0;         /* anz_designs-1 */
+THREAD_LOCAL int anz_designs = 0;        /* no of designs after parsing */
+
+THREAD_LOCAL opt_t opt;                  /* command line options */
+
+THREAD_LOCAL input_t input = INPUT_INITIALIZER;   /* input lines */
+
+
+
+/*       _\|/_
+         (o o)
+ +----oOO-{_}-OOo------------------------------------------------------------+
+ |                           F u n c t i o n s                               |
+ +--------------------------------------------------------------------------*/
+
+
+void set_default_options()
+/*
+ *  Reset all options to their default values.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    memset (&opt, 0, sizeof(opt_t));
+    opt.tabstop = DEF_TABSTOP;
+    opt.tabexp = 'e';
+    opt.killblank = -1;
+    opt.certainty = 100;
+    opt.spoolsize = DEF_SPOOLSIZE;
+    for (i=0; i<ANZ_SIDES; ++i)
+        opt.padding[i] = -1;
+}
+
+
+
+int set_option (const int oc, char *arg)
+/*
+ *  Set one of the options which control how the box is drawn or removed.
+ *  These are the same for the command line and the library.
+ *
+ *    oc    option character, as on the command line
+ *    arg   option argument (may be modified temporarily)
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (invalid option or argument)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int    idummy;
+    long   ldummy;
+    char  *pdummy;
+    char   c;
+    int    errfl = 0;                    /* true on error */
+    size_t optlen;
+
+    switch (oc) {
+
+        case 'a':
+            /*
+             *  Alignment/positioning of text inside box
+             */
+            errfl = 0;
+            pdummy = arg;
+            while (*pdummy) {
+                if (pdummy[1] == '\0' && !strchr ("lLcCrR", *pdummy)) {
+                    errfl = 1;
+                    break;
+                }
+                switch (*pdummy) {
+                    case 'h': case 'H':
+                        switch (pdummy[1]) {
+                            case 'c': case 'C': opt.halign = 'c'; break;
+                            case 'l': case 'L': opt.halign = 'l'; break;
+                            case 'r': case 'R': opt.halign = 'r'; break;
+                            default:            errfl = 1;        break;
+                        }
+                        ++pdummy;
+                        break;
+                    case 'v': case 'V':
+                        switch (pdummy[1]) {
+                            case 'c': case 'C': opt.valign = 'c'; break;
+                            case 't': case 'T': opt.valign = 't'; break;
+                            case 'b': case 'B': opt.valign = 'b'; break;
+                            default:            errfl = 1;        break;
+                        }
+                        ++pdummy;
+                        break;
+                    case 'j': case 'J':
+                        switch (pdummy[1]) {
+                            case 'l': case 'L': opt.justify = 'l'; break;
+                            case 'c': case 'C': opt.justify = 'c'; break;
+                            case 'r': case 'R': opt.justify = 'r'; break;
+                            default:            errfl = 1;         break;
+                        }
+                        ++pdummy;
+                        break;
+                    case 'l': case 'L':
+                        opt.justify = 'l';
+                        opt.halign = 'l';
+                        opt.valign = 'c';
+                        break;
+                    case 'r': case 'R':
+                        opt.justify = 'r';
+                        opt.halign = 'r';
+                        opt.valign = 'c';
+                        break;
+                    case 'c': case 'C':
+                        opt.justify = 'c';
+                        opt.halign = 'c';
+                        opt.valign = 'c';
+                        break;
+                    default:
+                        errfl = 1;
+                        break;
+                }
+                if (errfl)
+                    break;
+                else
+                    ++pdummy;
+            }
+            if (errfl) {
+                fprintf (stderr, "%s: Illegal text format -- %s\n",
+                        PROJECT, arg);
+                return 1;
+            }
+            break;
+
+        case 'b':
+            /*
+             *  Record mode: box each line (l), each paragraph (p), or
+             *  each block of lines ended by a separator line (s<sep>)
+             */
+            if (arg[0] == 'l' && arg[1] == '\0')
+                opt.recmode = 'l';
+            else if (arg[0] == 'p' && arg[1] == '\0')
+                opt.recmode = 'p';
+            else if (arg[0] == 's' && arg[1] != '\0') {
+                opt.recmode = 's';
+                BFREE (opt.recsep);
+                opt.recsep = (char *) strdup (arg + 1);
+                if (opt.recsep == NULL) {
+                    perror (PROJECT);
+                    return 1;
+                }
+            }
+            else {
+                fprintf (stderr, "%s: invalid record mode -- %s\n",
+                        PROJECT, arg);
+                return 1;
+            }
+            break;
+
+        case 'i':
+            /*
+             *  Indentation mode
+             */
+            optlen = strlen (arg);
+            if (optlen <= 3 && !strncasecmp ("box", arg, optlen))
+                opt.indentmode = 'b';
+            else if (optlen <= 4 && !strncasecmp ("text", arg, optlen))
+                opt.indentmode = 't';
+            else if (optlen <= 4 && !strncasecmp ("none", arg, optlen))
+                opt.indentmode = 'n';
+            else {
+                fprintf (stderr, "%s: invalid indentation mode\n", PROJECT);
+                return 1;
+            }
+            break;
+
+        case 'k':
+            /*
+             *  Kill blank lines or not [default: design-dependent]
+             */
+            if (opt.killblank == -1) {
+                if (strisyes (arg))
+                    opt.killblank = 1;
+                else if (strisno (arg))
+                    opt.killblank = 0;
+                else {
+                    fprintf (stderr, "%s: -k: invalid parameter\n", PROJECT);
+                    return 1;
+                }
+            }
+            break;
+
+        case 'p':
+            /*
+             *  Padding. format is ([ahvtrbl]n)+
+             */
+            errfl = 0;
+            pdummy = arg;
+            while (*pdummy) {
+                if (pdummy[1] == '\0') {
+                    errfl = 1;
+                    break;
+                }
+                c = *pdummy;
+                errno = 0;
+                idummy = (int) strtol (pdummy+1, &pdummy, 10);
+                if (errno || idummy < 0) {
+                    errfl = 1;
+                    break;
+                }
+                switch (c) {
+                    case 'a': case 'A':
+                        opt.padding[BTOP] = idummy;
+                        opt.padding[BBOT] = idummy;
+                        opt.padding[BLEF] = idummy;
+                        opt.padding[BRIG] = idummy;
+                        break;
+                    case 'h': case 'H':
+                        opt.padding[BLEF] = idummy;
+                        opt.padding[BRIG] = idummy;
+                        break;
+                    case 'v': case 'V':
+                        opt.padding[BTOP] = idummy;
+                        opt.padding[BBOT] = idummy;
+                        break;
+                    case 't': case 'T':
+                        opt.padding[BTOP] = idummy;
+                        break;
+                    case 'l': case 'L':
+                        opt.padding[BLEF] = idummy;
+                        break;
+                    case 'b': case 'B':
+                        opt.padding[BBOT] = idummy;
+                        break;
+                    case 'r': case 'R':
+                        opt.padding[BRIG] = idummy;
+                        break;
+                    default:
+                        errfl = 1;
+                        break;
+                }
+                if (errfl)
+                    break;
+            }
+            if (errfl) {
+                fprintf (stderr, "%s: invalid padding specification - "
+                        "%s\n", PROJECT, arg);
+                return 1;
+            }
+            break;
+
+        case 'q':
+            /*
+             *  Quick autodetection: Percentage of the highest possible score
+             *  at which a design is accepted without looking further
+             */
+            errno = 0;
+            idummy = (int) strtol (arg, &pdummy, 10);
+            if (errno || pdummy == arg || *pdummy != '\0'
+                    || idummy < 1 || idummy > 100) {
+                fprintf (stderr, "%s: invalid autodetection certainty -- %s\n",
+                        PROJECT, arg);
+                return 1;
+            }
+            opt.certainty = idummy;
+            break;
+
+        case 's':
+            /*
+             *  Specify desired box target size
+             */
+            pdummy = strchr (arg, 'x');
+            if (!pdummy) pdummy = strchr (arg, 'X');
+            if(pdummy) {
+                *pdummy = '\0';
+            }
+            errno = 0;
+            if (arg != pdummy) opt.reqwidth = strtol (arg, NULL, 10);
+            if (pdummy) {
+                opt.reqheight = strtol (pdummy+1, NULL, 10);
+                *pdummy = 'x';
+            }
+            if(errno){
+                fprintf (stderr, "%s: box size: %s, '%s'\n",
+                        PROJECT, strerror(errno), arg);
+                return 1;
+            } else if ((opt.reqwidth == 0 && opt.reqheight == 0)
+              || opt.reqwidth < 0 || opt.reqheight < 0) {
+                fprintf (stderr, "%s: invalid box size specification -- %s\n",
+                        PROJECT, arg);
+                return 1;
+            }
+            break;
+
+        case 't':
+            /*
+             *  Tab handling. Format is n[eku]
+             */
+            idummy = (int) strtol (arg, &pdummy, 10);
+            if (idummy < 1 || idummy > MAX_TABSTOP) {
+                fprintf (stderr, "%s: invalid tab stop distance -- %d\n",
+                        PROJECT, idummy);
+                return 1;
+            }
+            opt.tabstop = idummy;
+
+            errfl = 0;
+            if (*pdummy != '\0') {
+                if (pdummy[1] != '\0') {
+                    errfl = 1;
+                }
+                else {
+                    switch (*pdummy) {
+                        case 'e': case 'E':
+                            opt.tabexp = 'e';
+                            break;
+                        case 'k': case 'K':
+                            opt.tabexp = 'k';
+                            break;
+                        case 'u': case 'U':
+                            opt.tabexp = 'u';
+                            break;
+                        default:
+                            errfl = 1;
+                            break;
+                    }
+                }
+            }
+            if (errfl) {
+                fprintf (stderr, "%s: invalid tab handling specification - "
+                        "%s\n", PROJECT, arg);
+                return 1;
+            }
+            break;
+
+        case 'z':
+            /*
+             *  Input size beyond which a temporary file is used
+             */
+            errno = 0;
+            ldummy = strtol (arg, &pdummy, 10);
+            switch (*pdummy) {
+                case 'k': case 'K': ldummy *= 1024L; ++pdummy; break;
+                case 'm': case 'M': ldummy *= 1024L*1024; ++pdummy; break;
+                case 'g': case 'G': ldummy *= 1024L*1024*1024; ++pdummy; break;
+                default: break;
+            }
+            if (errno || ldummy < 0 || pdummy == arg || *pdummy != '\0') {
+                fprintf (stderr, "%s: invalid input size limit -- %s\n",
+                        PROJECT, arg);
+                return 1;
+            }
+            opt.spoolsize = (size_t) ldummy;
+            break;
+
+        default:
+            fprintf (stderr, "%s: internal error\n", PROJECT);
+            return 1;
+    }
+
+    return 0;
+}
+
+
+
+static void apply_options_to (design_t *d)
+/*
+ *  Adjust box size and indentmode of design d to the options.
+ *  Increase box width/height by width/height of empty sides in order
+ *  to match appearance of box with the user's expectations (if -s).
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (opt.reqheight > (long) d->minheight)
+        d->minheight = opt.reqheight;
+    if (opt.reqwidth > (long) d->minwidth)
+        d->minwidth = opt.reqwidth;
+    if (opt.reqwidth) {
+        if (d->metrics.empty[BRIG])
+            d->minwidth  += d->shape[SE].width;
+        if (d->metrics.empty[BLEF])
+            d->minwidth  += d->shape[NW].width;
+    }
+    if (opt.reqheight) {
+        if (d->metrics.empty[BTOP])
+            d->minheight += d->shape[NW].height;
+        if (d->metrics.empty[BBOT])
+            d->minheight += d->shape[SE].height;
+    }
+    if (opt.indentmode)
+        d->indentmode = opt.indentmode;
+}
+
+
+
+void apply_design_options()
+/*
+ *  Adjust the designs to be drawn to the options. These are the current
+ *  design and those of any outer boxes (-d a,b), or the target design
+ *  when converting (-x). Each design is adjusted only once.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i, j;
+
+    apply_options_to (opt.target? opt.target: opt.design);
+    for (i=0; i<opt.anz_stack; ++i) {
+        if (opt.stack[i] == opt.design)
+            continue;
+        for (j=0; j<i && opt.stack[j] != opt.stack[i]; ++j)
+            ;
+        if (j == i)
+            apply_options_to (opt.stack[i]);
+    }
+}
+
+
+
+static int get_indent (const line_t *lines, const size_t lanz)
+/*
+ *  Determine indentation of given lines in spaces.
+ *
+ *      lines   the lines to examine
+ *      lanz    number of lines to examine
+ *
+ *  Lines are assumed to be free of trailing whitespace.
+ *
+ *  RETURNS:    >= 0   indentation in spaces
+ *               < 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t j;
+    int    res = LINE_MAX;               /* result */
+    int    nonblank = 0;                 /* true if one non-blank line found */
+
+    if (lines == NULL) {
+        fprintf (stderr, "%s: internal error\n", PROJECT);
+        return -1;
+    }
+    if (lanz == 0)
+        return 0;
+
+    for (j=0; j<lanz; ++j) {
+        if (lines[j].len > 0) {
+            size_t ispc;
+            nonblank = 1;
+            ispc = strspn (lines[j].text, " ");
+            if ((int) ispc < res)
+                res = ispc;
+        }
+    }
+
+    if (nonblank)
+        return res;                      /* success */
+    else
+        return 0;                        /* success, but only blank lines */
+}
+
+
+
+static int compile_rules (reprule_t *rules, const size_t anz_rules)
+/*
+ *  Compile the regular expressions of the given rules, unless this has
+ *  already been done before.
+ *
+ *    rules       the rules to compile
+ *    anz_rules   number of entries in rules
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t j;
+
+    errno = 0;
+    opt.design->current_rule = rules;
+    for (j=0; j<anz_rules; ++j, ++(opt.design->current_rule)) {
+        if (rules[j].prog == NULL)
+            rules[j].prog = regcomp (rules[j].search);
+    }
+    opt.design->current_rule = NULL;
+    if (errno) return 3;
+
+    return 0;
+}
+
+
+
+static int substitute_line (reprule_t *rules, const size_t anz_rules,
+        line_t *line)
+/*
+ *  Apply regular expression substitutions to one line of input text.
+ *
+ *    rules       the compiled rules to apply
+ *    anz_rules   number of entries in rules
+ *    line        the line to modify
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t j;
+    char   buf[LINE_MAX*2];
+    size_t buf_len;                      /* length of string in buf */
+
+    opt.design->current_rule = rules;
+    for (j=0; j<anz_rules; ++j, ++(opt.design->current_rule)) {
+        #ifdef REGEXP_DEBUG
+            fprintf (stderr, "myregsub (0x%p, \"%s\", %d, \"%s\", buf, %d, \'%c\') == ",
+                    rules[j].prog, line->text, line->len, rules[j].repstr,
+                    LINE_MAX*2, rules[j].mode);
+        #endif
+        errno = 0;
+        buf_len = myregsub (rules[j].prog, line->text, line->len,
+                rules[j].repstr, buf, LINE_MAX*2, rules[j].mode);
+        #ifdef REGEXP_DEBUG
+            fprintf (stderr, "%d\n", buf_len);
+        #endif
+        if (errno) return 1;
+
+        BFREE (line->text);
+        line->text = (char *) strdup (buf);
+        if (line->text == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        line->len = buf_len;
+        #ifdef REGEXP_DEBUG
+            fprintf (stderr, "line == {%d, \"%s\"}\n", line->len, line->text);
+        #endif
+    }
+    opt.design->current_rule = NULL;
+
+    return 0;
+}
+
+
+
+static int revert_line (reprule_t *rules, const size_t anz_rules, line_t *line)
+/*
+ *  Apply the reversion rules to one line of a box removed. The line is
+ *  padded with the spaces recorded by strip_box() while the rules are
+ *  applied, so that they see the same text as when removal padded all
+ *  lines. The spaces are trimmed again afterwards.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *tmp;
+    int   rc;
+
+    if (line->padding == 0)
+        return substitute_line (rules, anz_rules, line);
+
+    tmp = (char *) realloc (line->text, line->len + line->padding + 1);
+    if (tmp == NULL) {
+        perror (PROJECT);
+        return 1;
+    }
+    memset (tmp + line->len, ' ', line->padding);
+    line->len += line->padding;
+    tmp[line->len] = '\0';
+    line->text = tmp;
+    line->padding = 0;
+
+    rc = substitute_line (rules, anz_rules, line);
+    if (rc)
+        return rc;
+    btrim (line->text, &(line->len));
+    tmp = (char *) realloc (line->text, line->len + 1);
+    if (tmp != NULL)
+        line->text = tmp;
+    return 0;
+}
+
+
+
+static int apply_substitutions (const int mode)
+/*
+ *  Apply regular expression substitutions to input text.
+ *
+ *    mode == 0   use replacement rules (box is being *drawn*)
+ *         == 1   use reversion rules (box is being *removed*)
+ *
+ *  Attn: This modifies the actual input array!
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t     anz_rules;
+    reprule_t *rules;
+    size_t     k;
+    int        rc;
+
+    if (opt.design == NULL)
+        return 1;
+
+    if (mode == 0) {
+        anz_rules = opt.design->anz_reprules;
+        rules = opt.design->reprules;
+    }
+    else if (mode == 1) {
+        anz_rules = opt.design->anz_revrules;
+        rules = opt.design->revrules;
+    }
+    else {
+        fprintf (stderr, "%s: internal error\n", PROJECT);
+        return 2;
+    }
+
+    /*
+     *  Compile regular expressions
+     */
+    rc = compile_rules (rules, anz_rules);
+    if (rc) return rc;
+
+    /*
+     *  Apply regular expression substitutions to input lines
+     */
+    for (k=0; k<input.anz_lines; ++k) {
+        if (mode == 1)
+            rc = revert_line (rules, anz_rules, input.lines + k);
+        else
+            rc = substitute_line (rules, anz_rules, input.lines + k);
+        if (rc) return rc;
+        if (input.lines[k].len > input.maxline)
+            input.maxline = input.lines[k].len;
+    }
+
+    /*
+     *  If text indentation was part of the lines processed, indentation
+     *  may now be different -> recalculate input.indent.
+     */
+    if (opt.design->indentmode == 't') {
+        rc = get_indent (input.lines, input.anz_lines);
+        if (rc >= 0)
+            input.indent = (size_t) rc;
+        else
+            return 4;
+    }
+
+    return 0;
+}
+
+
+
+static int import_line (char *buf, line_t *line)
+/*
+ *  Turn a line of raw input into an input line. Depending on whether a box
+ *  is being drawn or removed, either trailing whitespace or only the line
+ *  break is removed from the text. Tabs are expanded.
+ *
+ *    buf    raw input line as read by fgets() (will be modified)
+ *    line   RESULT: the input line
+ *
+ *  RETURNS:  != 0   on error (out of memory)
+ *            == 0   on success
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char   *temp = NULL;                 /* string resulting from tab exp. */
+    size_t  newlen;                      /* line length after tab expansion */
+
+    memset (line, 0, sizeof(line_t));
+    line->len = strlen (buf);
+
+    if (opt.r) {
+        if (line->len > 0 && buf[line->len-1] == '\n')
+            buf[--(line->len)] = '\0';
+    }
+    else {
+        btrim (buf, &(line->len));
+    }
+
+    if (line->len > 0) {
+        newlen = expand_tabs_into (buf, line->len, opt.tabstop, &temp,
+                &(line->tabpos), &(line->tabpos_len));
+        if (newlen == 0) {
+            perror (PROJECT);
+            return 1;
+        }
+        line->text = temp;
+        line->len = newlen;
+    }
+    else {
+        line->text = (char *) strdup (buf);
+    }
+
+    return 0;
+}
+
+
+
+static void set_padding()
+/*
+ *  Apply the padding values requested on the command line to the design.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+
+    for (i=0; i<ANZ_SIDES; ++i) {
+        if (opt.padding[i] > -1)
+            opt.design->padding[i] = opt.padding[i];
+    }
+}
+
+
+
+static void adjust_padding()
+/*
+ *  Adjust box size to fit requested padding value.
+ *  Command line-specified box size takes precedence over padding.
+ *
+ *  Depends on the size of the input text, so input.anz_lines and
+ *  input.maxline must be set.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t pad;
+    int    i;
+
+    set_padding();
+    pad  = opt.design->padding[BTOP] + opt.design->padding[BBOT];
+    if (pad > 0) {
+        pad += input.anz_lines;
+        pad += opt.design->shape[NW].height + opt.design->shape[SW].height;
+        if (pad > opt.design->minheight) {
+            if (opt.reqheight) {
+                for (i=0; i<(int)(pad-opt.design->minheight); ++i) {
+                    if (opt.design->padding[i%2?BBOT:BTOP])
+                        opt.design->padding[i%2?BBOT:BTOP] -= 1;
+                    else if (opt.design->padding[i%2?BTOP:BBOT])
+                        opt.design->padding[i%2?BTOP:BBOT] -= 1;
+                    else
+                        break;
+                }
+            }
+            else {
+                opt.design->minheight = pad;
+            }
+        }
+    }
+    pad = opt.design->padding[BLEF] + opt.design->padding[BRIG];
+    if (pad > 0) {
+        pad += input.maxline;
+        pad += opt.design->shape[NW].width + opt.design->shape[NE].width;
+        if (pad > opt.design->minwidth) {
+            if (opt.reqwidth) {
+                for (i=0; i<(int)(pad-opt.design->minwidth); ++i) {
+                    if (opt.design->padding[i%2?BRIG:BLEF])
+                        opt.design->padding[i%2?BRIG:BLEF] -= 1;
+                    else if (opt.design->padding[i%2?BLEF:BRIG])
+                        opt.design->padding[i%2?BLEF:BRIG] -= 1;
+                    else
+                        break;
+                }
+            }
+            else {
+                opt.design->minwidth = pad;
+            }
+        }
+    }
+}
+
+
+
+int stream_input()
+/*
+ *  Draw a box around the input while it is being read (-u).
+ *
+ *  The box size is taken from the command line (-s) instead of being
+ *  computed from the input text, so every line of text can be output as
+ *  soon as it has been read. Text indentation is retained inside the box,
+ *  since the indentation of the text as a whole is not known in advance.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char      buf[LINE_MAX+2];           /* input buffer */
+    line_t    line;
+    sentry_t  thebox[ANZ_SIDES];
+    long      fill;
+    int       i;
+    int       rc;
+
+    opt.design->indentmode = 't';
+    rc = compile_rules (opt.design->reprules, opt.design->anz_reprules);
+    if (rc)
+        return rc;
+
+    /*
+     *  Pretend the text fills the requested box exactly. This yields the
+     *  same box that would be drawn around any text which fits into it.
+     */
+    for (i=0; i<ANZ_SIDES; ++i) {
+        if (opt.padding[i] > -1)
+            opt.design->padding[i] = opt.padding[i];
+    }
+    fill = (long) opt.design->minwidth - (long) opt.design->shape[NW].width
+        - (long) opt.design->shape[NE].width
+        - opt.design->padding[BLEF] - opt.design->padding[BRIG];
+    input.maxline = fill > 0? (size_t) fill: 1;
+    fill = (long) opt.design->minheight - (long) opt.design->shape[NW].height
+        - (long) opt.design->shape[SW].height
+        - opt.design->padding[BTOP] - opt.design->padding[BBOT];
+    input.anz_lines = fill > 0? (size_t) fill: 1;
+    input.indent = 0;
+    adjust_padding();
+
+    memset (thebox, 0, sizeof(thebox));
+    rc = generate_box (thebox);
+    if (rc)
+        return rc;
+
+    while (fgets (buf, LINE_MAX+1, opt.infile)) {
+        rc = import_line (buf, &line);
+        if (rc == 0)
+            rc = substitute_line (opt.design->reprules,
+                    opt.design->anz_reprules, &line);
+        if (rc == 0)
+            rc = output_box_line (thebox, &line);
+        BFREE (line.text);
+        BFREE (line.tabpos);
+        if (rc)
+            return rc;
+    }
+    if (ferror (opt.infile)) {
+        perror (PROJECT);
+        return 1;
+    }
+
+    return output_box_line (thebox, NULL);
+}
+
+
+
+static THREAD_LOCAL size_t spool_indent = LINE_MAX;  /* indentation of spooled input */
+
+static int spool_line (line_t *line)
+/*
+ *  Append one line of input to the spool file, keeping track of the input
+ *  statistics. The memory occupied by the line is freed.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int rc;
+
+    if (line->len > input.maxline)
+        input.maxline = line->len;
+    if (line->len > 0) {
+        size_t ispc = strspn (line->text, " ");
+        if (ispc < spool_indent)
+            spool_indent = ispc;
+    }
+
+    rc = spool_write (line);
+    BFREE (line->text);
+    BFREE (line->tabpos);
+    return rc;
+}
+
+
+
+static int spill_input()
+/*
+ *  Move all input lines read so far to a new spool file. From now on,
+ *  input lines are stored in the spool file rather than in memory.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t i;
+
+    if (spool_open())
+        return 1;
+    spool_indent = LINE_MAX;
+    for (i=0; i<input.anz_lines; ++i) {
+        if (spool_line (input.lines + i))
+            return 1;
+    }
+    BFREE (input.lines);
+    input.alloc_lines = 0;
+    input.spooled = 1;
+    return 0;
+}
+
+
+
+static int substitute_spooled (line_t *line)
+/*
+ *  Prepare one line of spooled input for output by applying the replacement
+ *  rules (callback for spool_rewrite()).
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int rc;
+
+    rc = substitute_line (opt.design->reprules, opt.design->anz_reprules, line);
+    if (rc)
+        return rc;
+
+    if (line->len > input.maxline)
+        input.maxline = line->len;
+    if (line->len > 0) {
+        size_t ispc = strspn (line->text, " ");
+        if (ispc < spool_indent)
+            spool_indent = ispc;
+    }
+    return 0;
+}
+
+
+
+static int finish_spooled_input()
+/*
+ *  Second part of read_all_input() for input which has been spooled.
+ *  Indentation is removed from the lines as they are read back from the
+ *  spool file. If there are replacement rules, the spool file is rewritten
+ *  with the rules applied, because their result affects the box size.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t strip = 0;                    /* indentation to remove */
+    int    rc;
+
+    input.indent = spool_indent < LINE_MAX? spool_indent: 0;
+    if (opt.design->indentmode != 't') {
+        strip = input.indent;
+        input.maxline -= input.indent;
+    }
+    rc = spool_rewind (strip);
+    if (rc)
+        return rc;
+
+    if (opt.design->anz_reprules > 0) {
+        rc = compile_rules (opt.design->reprules, opt.design->anz_reprules);
+        if (rc)
+            return rc;
+        spool_indent = LINE_MAX;
+        rc = spool_rewrite (substitute_spooled);
+        if (rc)
+            return rc;
+        if (opt.design->indentmode == 't')
+            input.indent = spool_indent < LINE_MAX? spool_indent: 0;
+    }
+
+    return 0;
+}
+
+
+
+static THREAD_LOCAL char recsep_buf[LINE_MAX+2];  /* separator which ended a record */
+static THREAD_LOCAL int  recsep_pending = 0;  /* true if recsep_buf is to be output */
+
+static int is_record_separator (const char *buf)
+/*
+ *  Determine whether the given raw input line separates two records (-b).
+ *
+ *    buf   raw input line as read by fgets()
+ *
+ *  RETURNS:  != 0   line is a record separator
+ *            == 0   line is part of a record
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t len;
+
+    switch (opt.recmode) {
+        case 'p':
+            return buf[strspn (buf, " \t\r\n")] == '\0';
+        case 's':
+            len = strcspn (buf, "\r\n");
+            return len == strlen (opt.recsep)
+                && strncmp (buf, opt.recsep, len) == 0;
+        default:
+            return 0;
+    }
+}
+
+
+
+static void clear_input()
+/*
+ *  Free the input lines, but keep the line array for reuse by the next
+ *  record or input file.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t i;
+
+    if (input.lines != NULL && !input.spooled) {
+        for (i=0; i<input.anz_lines; ++i) {
+            BFREE (input.lines[i].text);
+            BFREE (input.lines[i].tabpos);
+        }
+    }
+    input.anz_lines = 0;
+}
+
+
+
+static void next_record()
+/*
+ *  Finish the record just processed (-b). The separator line which ended
+ *  the record is output after the box.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (recsep_pending) {
+        fputs (recsep_buf, opt.outfile);
+        recsep_pending = 0;
+    }
+    clear_input();
+}
+
+
+
+static int prepare_input()
+/*
+ *  Second part of read_all_input(), which works on the lines in memory.
+ *  Compute the indentation of the text, and prepare the lines for drawing
+ *  a box by removing the indentation (depending on the indentation mode)
+ *  and applying the replacement rules.
+ *
+ *  RETURNS:  != 0   on error
+ *            == 0   on success
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t i;
+    int    rc;
+
+    /*
+     *  Compute indentation
+     */
+    rc = get_indent (input.lines, input.anz_lines);
+    if (rc >= 0)
+        input.indent = (size_t) rc;
+    else
+        return 1;
+
+    /*
+     *  Remove indentation, unless we want to preserve it (when removing
+     *  a box or if the user wants to retain it inside the box)
+     */
+    if (opt.design->indentmode != 't' && opt.r == 0) {
+        for (i=0; i<input.anz_lines; ++i) {
+            if (input.lines[i].len >= input.indent) {
+                memmove (input.lines[i].text, input.lines[i].text+input.indent,
+                        input.lines[i].len-input.indent+1);
+                input.lines[i].len -= input.indent;
+            }
+        }
+        input.maxline -= input.indent;
+    }
+
+    /*
+     *  Apply regular expression substitutions
+     */
+    if (opt.r == 0) {
+        if (apply_substitutions(0) != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+
+
+static int read_all_input()
+/*
+ *  Read entire input (possibly from stdin) and store it in 'input' array.
+ *  In record mode (-b), only the next record is read. Separator lines
+ *  preceding the record are output right away.
+ *
+ *  Tabs are expanded.
+ *  Might allocate slightly more memory than it needs. Trade-off for speed.
+ *
+ *  RETURNS:  != 0   on error (out of memory)
+ *            == 0   on success
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char    buf[LINE_MAX+2];             /* input buffer */
+    size_t  input_bytes = 0;             /* number of bytes read */
+    line_t *tmp = NULL;
+    line_t  line;
+
+    input.indent = LINE_MAX;
+    input.maxline = 0;
+    input.anz_lines = 0;
+    input.spooled = 0;
+
+    /*
+     *  Start reading
+     */
+    while (fgets (buf, LINE_MAX+1, opt.infile))
+    {
+        if (opt.recmode && is_record_separator (buf)) {
+            if (input.anz_lines == 0) {
+                fputs (buf, opt.outfile);
+                continue;
+            }
+            strcpy (recsep_buf, buf);
+            recsep_pending = 1;
+            break;
+        }
+
+        /*
+         *  Very large input goes to a spool file when drawing a box, so
+         *  the memory needed does not depend on the input size (-z).
+         *  Justification may change the width of the text block while
+         *  it is output, so it requires all lines to be in memory.
+         */
+        input_bytes += strlen (buf);
+        if (!input.spooled && input_bytes > opt.spoolsize
+                && opt.r == 0 && opt.justify == '\0' && opt.recmode != 'l')
+        {
+            if (spill_input())
+                return 1;
+        }
+        if (input.spooled) {
+            if (import_line (buf, &line) || spool_line (&line))
+                return 1;
+            ++input.anz_lines;
+            continue;
+        }
+
+        if (input.anz_lines == input.alloc_lines) {
+            input.alloc_lines = input.alloc_lines? 2*input.alloc_lines: 100;
+            tmp = (line_t *) realloc (input.lines, input.alloc_lines*sizeof(line_t));
+            if (tmp == NULL) {
+                perror (PROJECT);
+                BFREE (input.lines);
+                input.alloc_lines = 0;
+                return 1;
+            }
+            input.lines = tmp;
+        }
+
+        if (import_line (buf, input.lines + input.anz_lines)) {
+            BFREE (input.lines);
+            input.alloc_lines = 0;
+            return 1;
+        }
+
+        /*
+         *  Update length of longest line
+         */
+        if (input.lines[input.anz_lines].len > input.maxline)
+            input.maxline = input.lines[input.anz_lines].len;
+
+        /*
+         *  next please
+         */
+        ++input.anz_lines;
+        if (opt.recmode == 'l')
+            break;
+    }
+
+    if (ferror (opt.infile)) {
+        perror (PROJECT);
+        BFREE (input.lines);
+        input.alloc_lines = 0;
+        return 1;
+    }
+
+    if (input.spooled)
+        return finish_spooled_input();
+
+    /*
+     *  Exit if there was no input at all
+     */
+    if (input.lines == NULL || input.lines[0].text == NULL)
+        return 0;
+
+    if (prepare_input())
+        return 1;
+
+#if 0
+    /*
+     *  Debugging Code: Display contents of input structure
+     */
+    for (i=0; i<input.anz_lines; ++i) {
+        fprintf (stderr, "%3d [%02d] \"%s\"", i, input.lines[i].len,
+                input.lines[i].text);
+        fprintf (stderr, "\tTabs: [");
+        if (input.lines[i].tabpos != NULL) {
+            size_t j;
+            for (j=0; j<input.lines[i].tabpos_len; ++j) {
+                fprintf (stderr, "%d", input.lines[i].tabpos[j]);
+                if (j < input.lines[i].tabpos_len - 1) {
+                    fprintf (stderr, ", ");
+                }
+            }
+        }
+        fprintf (stderr, "] (%d)\n", input.lines[i].tabpos_len);
+    }
+    fprintf (stderr, "\nLongest line: %d characters.\n", input.maxline);
+    fprintf (stderr, " Indentation: %2d spaces.\n", input.indent);
+#endif
+
+    return 0;
+}
+
+
+static void output_plain (line_t *lines, const size_t anz)
+/*
+ *  Output lines which are not part of a box (-g). Each line keeps its own
+ *  indentation, so the lines come out as they went in, except for the
+ *  removal of trailing spaces.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t j;
+
+    for (j=0; j<anz; ++j) {
+        input.lines = lines + j;
+        input.anz_lines = 1;
+        input.indent = (size_t) get_indent (lines + j, 1);
+        output_input (0);
+    }
+}
+
+
+
+static int remove_all_boxes()
+/*
+ *  Remove every box from the input (-g), not just one around all of it.
+ *  Each box found is removed in place by running the regular removal on
+ *  just the lines of that box, all other lines are output unchanged.
+ *  The search for the next box continues where the previous one ended,
+ *  so the input is processed in one pass.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    input_t doc;                         /* the entire input */
+    size_t  done = 0;                    /* index of first line not output */
+    size_t  boxstart, boxend;            /* lines of the box found */
+    int     rc;
+
+    rc = prepare_removal();
+    if (rc)
+        return rc;
+    doc = input;
+
+    for (;;) {
+        input = doc;
+        if (find_box (done, &boxstart, &boxend))
+            break;
+        #ifdef DEBUG
+            fprintf (stderr, "Box found in lines %d to %d.\n",
+                    boxstart, boxend-1);
+        #endif
+
+        output_plain (doc.lines + done, boxstart - done);
+
+        input.lines = doc.lines + boxstart;
+        input.anz_lines = boxend - boxstart;
+        input.alloc_lines = input.anz_lines;
+        input.maxline = doc.maxline;
+        input.indent = (size_t) get_indent (input.lines, input.anz_lines);
+        rc = strip_box();
+        if (rc == 0)
+            rc = apply_substitutions (1);
+        if (rc)
+            break;
+        output_input (0);
+        done = boxend;
+    }
+
+    if (rc == 0)
+        output_plain (doc.lines + done, doc.anz_lines - done);
+    input = doc;
+    return rc;
+}
+
+static int redraw_input()
+/*
+ *  Turn the text left over from removing a box into the input for drawing
+ *  the mended box (-m), or the box of the target design when converting
+ *  (-x). The reversion rules are those of the design removed, while the
+ *  replacement rules are those of the design drawn. This does what
+ *  read_all_input() would do before
+ *  drawing, but the lines are already expanded and measured, so they are
+ *  not read again. The reversion rules and the replacement rules are
+ *  applied to each line in the same pass, which also collects the line
+ *  metrics. Only if indentation is to be removed from the text, the
+ *  replacement rules need a second pass, because the indentation of all
+ *  lines must be known first.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    design_t *src = opt.design;          /* design of the box removed */
+    design_t *d = opt.target? opt.target: opt.design;
+    int       unindent = d->indentmode != 't';   /* remove indentation */
+    size_t    indent = LINE_MAX;         /* indentation of text */
+    int       nonblank = 0;              /* true if a non-blank line found */
+    line_t   *line;
+    size_t    k;
+    int       rc;
+
+    rc = compile_rules (src->revrules, src->anz_revrules);
+    if (rc == 0)
+        rc = compile_rules (d->reprules, d->anz_reprules);
+    if (rc)
+        return rc;
+
+    input.maxline = 0;
+    for (k=0, line=input.lines; k<input.anz_lines; ++k, ++line) {
+        rc = revert_line (src->revrules, src->anz_revrules, line);
+        if (rc)
+            return rc;
+        btrim (line->text, &(line->len));
+        if (!unindent) {
+            if (line->len > input.maxline)
+                input.maxline = line->len;
+            rc = substitute_line (d->reprules, d->anz_reprules, line);
+            if (rc)
+                return rc;
+        }
+        if (line->len > input.maxline)
+            input.maxline = line->len;
+        if (line->len > 0) {
+            nonblank = 1;
+            indent = BMIN (indent, strspn (line->text, " "));
+        }
+    }
+    input.indent = nonblank? indent: 0;
+
+    if (unindent) {
+        input.maxline = 0;
+        for (k=0, line=input.lines; k<input.anz_lines; ++k, ++line) {
+            if (line->len >= input.indent) {
+                memmove (line->text, line->text + input.indent,
+                        line->len - input.indent + 1);
+                line->len -= input.indent;
+            }
+            if (line->len > input.maxline)
+                input.maxline = line->len;
+            rc = substitute_line (d->reprules, d->anz_reprules, line);
+            if (rc)
+                return rc;
+            if (line->len > input.maxline)
+                input.maxline = line->len;
+        }
+    }
+
+    return 0;
+}
+
+
+
+static int nest_box (const sentry_t *thebox, design_t *outer)
+/*
+ *  Make the box just generated the input text for drawing the next outer
+ *  box of a list of designs (-d a,b). The lines of the box go straight
+ *  into a new line array, which then replaces the input.
+ *
+ *    thebox    the generated box parts
+ *    outer     the design of the next outer box
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    input_t boxed = INPUT_INITIALIZER;
+    int     rc;
+
+    rc = render_box (thebox, &boxed);
+    if (input.spooled)
+        spool_close();
+    clear_input();
+    BFREE (input.lines);
+    input = boxed;
+    if (rc)
+        return rc;
+
+    opt.design = outer;
+    return prepare_input();
+}
+
+
+
+static int draw_box()
+/*
+ *  Draw a box around the input and output it. If a list of designs was
+ *  given (-d a,b), the box is drawn around the text, then the next box
+ *  around that box, and so on.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    sentry_t *thebox;
+    design_t *d;
+    size_t    saved_width;               /* d->minwidth backup */
+    size_t    saved_height;              /* d->minheight backup */
+    int       saved_padding[ANZ_SIDES];  /* d->padding backup */
+    int       stage;
+    int       rc = 0;
+
+    for (stage=0; rc == 0 && stage<=opt.anz_stack; ++stage) {
+        #ifdef DEBUG
+            fprintf (stderr, "Generating Box ...\n");
+        #endif
+        d = opt.design;
+        saved_width = d->minwidth;
+        saved_height = d->minheight;
+        memcpy (saved_padding, d->padding, sizeof(saved_padding));
+
+        adjust_padding();
+        thebox = (sentry_t *) calloc (ANZ_SIDES, sizeof(sentry_t));
+        if (thebox == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        rc = generate_box (thebox);
+        if (rc == 0) {
+            if (stage < opt.anz_stack) {
+                rc = nest_box (thebox, opt.stack[stage]);
+            }
+            else {
+                output_box (thebox);
+                if (input.spooled)
+                    spool_close();
+            }
+            free_box (thebox);
+        }
+        BFREE (thebox);
+
+        /*
+         *  A design may occur more than once in the list, so it must be
+         *  as before for the next box.
+         */
+        d->minwidth = saved_width;
+        d->minheight = saved_height;
+        memcpy (d->padding, saved_padding, sizeof(saved_padding));
+    }
+
+    return rc;
+}
+
+
+
+static int strip_input()
+/*
+ *  Remove the box from the input (-r), or all boxes (-g), and output the
+ *  result. When mending a box (-m), draw the box again instead, or draw a
+ *  box of the target design when converting (-x).
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    design_t *adjusted = opt.design;     /* see apply_design_options() */
+    design_t *removed;                   /* design of the box removed */
+    size_t    saved_width;               /* removed->minwidth backup */
+    size_t    saved_height;              /* removed->minheight backup */
+    char      saved_indentmode;          /* removed->indentmode backup */
+    int       rc;
+
+    #ifdef DEBUG
+        fprintf (stderr, "Removing Box ...\n");
+    #endif
+    if (opt.target == NULL)
+        set_padding();                   /* else -p is for the target */
+    if (opt.killblank == -1) {
+        if (opt.design->metrics.empty[BTOP]
+                && opt.design->metrics.empty[BBOT])
+            opt.killblank = 0;
+        else
+            opt.killblank = 1;
+    }
+
+    if (opt.global)
+        return remove_all_boxes();
+
+    rc = remove_box();
+    if (rc)
+        return rc;
+
+    if (opt.mend) {
+        if (input.anz_lines == 0)
+            return 0;
+
+        /*
+         *  The options were applied to the design given, not to the design
+         *  autodetected. Apply them to the latter for drawing it again.
+         */
+        removed = opt.design;
+        saved_width = removed->minwidth;
+        saved_height = removed->minheight;
+        saved_indentmode = removed->indentmode;
+        if (opt.target == NULL && removed != adjusted)
+            apply_options_to (removed);
+        rc = redraw_input();
+        if (rc == 0) {
+            if (opt.target)
+                opt.design = opt.target;
+            rc = draw_box();
+        }
+        removed->minwidth = saved_width;
+        removed->minheight = saved_height;
+        removed->indentmode = saved_indentmode;
+        return rc;
+    }
+
+    rc = apply_substitutions (1);
+    if (rc)
+        return rc;
+    output_input (0);
+    return 0;
+}
+
+
+
+int process_input()
+/*
+ *  Draw or remove the box(es) around the input read from opt.infile and
+ *  write the result to opt.outfile. Afterwards, the design is restored to
+ *  its previous state, so that further input may be processed with it
+ *  (batch mode).
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int       rc = 0;
+    design_t *saved_design = opt.design; /* opt.design backup, may be autodetected */
+    design_t *drawn;                     /* design of the box drawn */
+    size_t    saved_designwidth;         /* drawn->minwith backup */
+    size_t    saved_designheight;        /* drawn->minheight backup */
+    int       saved_padding[ANZ_SIDES];  /* drawn->padding backup */
+    int       saved_killblank = opt.killblank;
+
+    drawn = opt.target? opt.target: opt.design;
+    saved_designwidth = drawn->minwidth;
+    saved_designheight = drawn->minheight;
+    memcpy (saved_padding, drawn->padding, sizeof(saved_padding));
+
+    for (;;) {
+        #ifdef DEBUG
+            fprintf (stderr, "Reading all input ...\n");
+        #endif
+        rc = read_all_input();
+        if (rc || input.anz_lines == 0)
+            break;
+
+        if (opt.r)
+            rc = strip_input();
+        else
+            rc = draw_box();
+        if (rc)
+            break;
+
+        /*
+         *  In record mode, process the next record using the same design.
+         *  The end of input is detected by read_all_input() above.
+         */
+        if (opt.recmode == '\0')
+            break;
+        next_record();
+        opt.design = saved_design;
+        drawn->minwidth = saved_designwidth;
+        drawn->minheight = saved_designheight;
+        memcpy (drawn->padding, saved_padding, sizeof(saved_padding));
+    }
+
+    clear_input();
+    opt.design = saved_design;
+    drawn->minwidth = saved_designwidth;
+    drawn->minheight = saved_designheight;
+    memcpy (drawn->padding, saved_padding, sizeof(saved_padding));
+    opt.killblank = saved_killblank;
+    return rc;
+}
+
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
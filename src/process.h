@@ -0,0 +1,41 @@
+/*
+ *  File:             process.h
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 14:03h)
+ *  Author:           Copyright (C) 1999 Thomas Jensen <boxes@thomasjensen.com>
+ *                    Split off from boxes.c by agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Option handling and processing of the input text
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#ifndef PROCESS_H
+#define PROCESS_H
+
+
+void set_default_options();
+int  set_option (const int oc, char *arg);
+void apply_design_options();
+
+int  process_input();
+int  stream_input();
+
+
+#endif /*PROCESS_H*/
+
+/*EOF*/                                          /* vim: set cindent sw=4: */
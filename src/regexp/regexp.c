@@ -21,7 +21,12 @@
  * Beware that some of this code is subtly aware of the way operator
  * precedence is structured in regular expressions.  Serious changes in
  * regular-expression syntax might require a total rethink.
+ *
+ * Altered for boxes by Thomas Jensen: The global work variables are
+ * private to each thread (THREAD_LOCAL), so that regcomp() and regexec()
+ * may be called by several threads at once.
  */
+#include "config.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -149,11 +154,11 @@ char rcsid_regexp_c[] =
 /*
  * Global work variables for regcomp().
  */
-static char *regparse;		/* Input-scan pointer. */
-static int regnpar;		/* () count. */
+static THREAD_LOCAL char *regparse;	/* Input-scan pointer. */
+static THREAD_LOCAL int regnpar;	/* () count. */
 static char regdummy;
-static char *regcode;		/* Code-emit pointer; &regdummy = don't. */
-static long regsize;		/* Code size. */
+static THREAD_LOCAL char *regcode;	/* Code-emit pointer; &regdummy = don't. */
+static THREAD_LOCAL long regsize;	/* Code size. */
 
 /*
  * Forward declarations for regcomp()'s friends.
@@ -680,10 +685,10 @@ char *val;
 /*
  * Global work variables for regexec().
  */
-static char *reginput;		/* String-input pointer. */
-static char *regbol;		/* Beginning of input, for ^ check. */
-static char **regstartp;	/* Pointer to startp array. */
-static char **regendp;		/* Ditto for endp. */
+static THREAD_LOCAL char *reginput;	/* String-input pointer. */
+static THREAD_LOCAL char *regbol;	/* Beginning of input, for ^ check. */
+static THREAD_LOCAL char **regstartp;	/* Pointer to startp array. */
+static THREAD_LOCAL char **regendp;	/* Ditto for endp. */
 
 /*
  * Forwards.
@@ -31,6 +31,7 @@
 #include "boxes.h"
 #include "tools.h"
 #include "remove.h"
+#include "detcache.h"
 
 static const char rcsid_remove_c[] =
     "$Id: remove.c,v 1.8 2006/07/22 19:19:26 tsjensen Exp $";
@@ -38,184 +39,341 @@ static const char rcsid_remove_c[] =
 
 
 
-static int best_match (const line_t *line,
-        char **ws, char **we, char **es, char **ee)
+static size_t add_trims (trimmed_t *trims, size_t anz, char *chars,
+        const size_t width)
 /*
- *  Find positions of west and east box parts in line.
+ *  Append the variants of a shape line which are tried when looking for it
+ *  in an input line. If the full shape line cannot be found, leading spaces
+ *  are removed one by one, then trailing spaces.
  *
- *    line      line to examine
- *    ws etc.   result parameters (west start, west end, east start, east end)
+ *    trims   list of variants to append to
+ *    anz     number of entries in trims so far
+ *    chars   shape line
+ *    width   length of shape line
  *
- *  RETURNS:    > 0   a match was found (ws etc are set to indicate positions)
- *             == 0   no match was found
- *              < 0   internal error (out of memory)
+ *  RETURNS:  new number of entries in trims
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char   *s = chars;
+    size_t  cq = width;
+    size_t  i;
+
+    while (cq) {
+        trims[anz].text = s;
+        trims[anz].len = cq;
+        for (i=0; i<cq && s[i] == ' '; ++i);
+        trims[anz].lead = i;
+        for (i=0; i<cq && s[cq-1-i] == ' '; ++i);
+        trims[anz].trail = i;
+        ++anz;
+
+        if (*s == ' ') {
+            ++s;
+            --cq;
+        }
+        else if (s[cq-1] == ' ')
+            --cq;
+        else
+            break;
+    }
+    return anz;
+}
+
+
+
+static void sort_trims (trimmed_t *trims, const size_t anz)
+/*
+ *  Sort variants by quality, best first. Variants of equal quality remain
+ *  in their original order, because the first one found wins.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    trimmed_t t;
+    size_t    i;
+    size_t    j;
+
+    for (i=1; i<anz; ++i) {
+        t = trims[i];
+        for (j=i; j>0 && trims[j-1].len < t.len; --j)
+            trims[j] = trims[j-1];
+        trims[j] = t;
+    }
+}
+
+
+
+int build_trims (design_t *d)
+/*
+ *  Precompute the variants of the west and east side shape lines of design
+ *  d which best_match() looks for, sorted by match quality. A blank last
+ *  line of the west side is only tried if no other west shape line
+ *  matches, so its variants are appended after sorting.
+ *  Also precompute the corner shape lines which detect_design() looks for.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory)
  *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    size_t    numw = 0;                /* number of shape lines on west side */
-    size_t    nume = 0;                /* number of shape lines on east side */
-    size_t    j;                       /* counts number of lines of all shapes tested */
+    size_t    numw;                    /* number of shape lines on west side */
+    size_t    nume;                    /* number of shape lines on east side */
+    size_t    j;                       /* counts number of lines of all shapes */
     size_t    k;                       /* line counter within shape */
     int       w;                       /* shape counter */
     sentry_t *cs;                      /* current shape */
-    char     *s;                       /* duplicate of current shape part */
-    char     *p;                       /* position found by strstr */
-    size_t    cq;                      /* current quality */
-    char     *q;                       /* space check rover */
     line_t    chkline;                 /* for calls to empty_line() */
-    size_t    quality;
-
-    *ws = *we = *es = *ee = NULL;
+    sentry_t *fallback = NULL;         /* shape of blank last west line */
+    size_t    anz;
+    trimmed_t *t;
+    int       c;
 
-    numw  = opt.design->shape[WNW].height;
-    numw += opt.design->shape[ W ].height;
-    numw += opt.design->shape[WSW].height;
+    BFREE (d->west_trims);
+    BFREE (d->east_trims);
+    BFREE (d->corner_trims);
+    d->anz_west_trims = 0;
+    d->anz_east_trims = 0;
+    memset (d->anz_corner_trims, 0, sizeof(d->anz_corner_trims));
 
-    nume  = opt.design->shape[ENE].height;
-    nume += opt.design->shape[ E ].height;
-    nume += opt.design->shape[ESE].height;
-
-    #ifdef DEBUG
-        fprintf (stderr, "Number of WEST side shape lines: %d\n", numw);
-        fprintf (stderr, "Number of EAST side shape lines: %d\n", nume);
-    #endif
+    numw = d->shape[WNW].height + d->shape[W].height + d->shape[WSW].height;
+    nume = d->shape[ENE].height + d->shape[E].height + d->shape[ESE].height;
 
     /*
-     *  Find match for WEST side
+     *  West side
      */
-    if (!empty_side (opt.design->shape, BLEF)) {
-        quality = 0;
-        cs = opt.design->shape + WNW;
+    if (!d->metrics.empty[BLEF]) {
+        d->west_trims = (trimmed_t *) malloc
+            (numw * (d->shape[NW].width+1) * sizeof(trimmed_t));
+        if (d->west_trims == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        anz = 0;
+        cs = d->shape + WNW;
         for (j=0,k=0,w=3; j<numw; ++j,++k) {
             if (k == cs->height) {
                 k = 0;
-                cs = opt.design->shape + west_side[--w];
+                cs = d->shape + west_side[--w];
             }
-
             chkline.text = cs->chars[k];
             chkline.len = cs->width;
-            if (empty_line (&chkline) && !(quality==0 && j==numw-1))
-                continue;
-
-            s = (char *) strdup (cs->chars[k]);
-            if (s == NULL) {
-                perror (PROJECT);
-                return -1;
-            }
-            cq = cs->width;
-
-            do {
-                p = strstr (line->text, s);
-                if (p) {
-                    q = p-1;
-                    while (q >= line->text) {
-                        if (*q-- != ' ') {
-                            p = NULL;
-                            break;
-                        }
-                    }
-                    if (p)
-                        break;
-                }
-                if (!p && cq) {
-                    if (*s == ' ')
-                        memmove (s, s+1, cq--);
-                    else if (s[cq-1] == ' ')
-                        s[--cq] = '\0';
-                    else {
-                        cq = 0;
-                        break;
-                    }
-                }
-            } while (cq && !p);
-
-            if (cq == 0) {
-                BFREE (s);
+            if (empty_line (&chkline)) {
+                if (j == numw-1)
+                    fallback = cs;
                 continue;
             }
-
-            /*
-            *  If the current match is the best yet, adjust result values
-            */
-            if (cq > quality) {
-                quality = cq;
-                *ws = p;
-                *we = p + cq;
-            }
-
-            BFREE (s);
+            anz = add_trims (d->west_trims, anz, cs->chars[k], cs->width);
         }
+        sort_trims (d->west_trims, anz);
+        if (fallback)
+            anz = add_trims (d->west_trims, anz,
+                    fallback->chars[fallback->height-1], fallback->width);
+        d->anz_west_trims = anz;
     }
 
     /*
-     *  Find match for EAST side
+     *  East side
      */
-    if (!empty_side (opt.design->shape, BRIG)) {
-        quality = 0;
-        cs = opt.design->shape + ENE;
+    if (!d->metrics.empty[BRIG]) {
+        d->east_trims = (trimmed_t *) malloc
+            (nume * (d->shape[NE].width+1) * sizeof(trimmed_t));
+        if (d->east_trims == NULL) {
+            perror (PROJECT);
+            BFREE (d->west_trims);
+            return 1;
+        }
+        anz = 0;
+        cs = d->shape + ENE;
         for (j=0,k=0,w=1; j<nume; ++j,++k) {
             if (k == cs->height) {
                 k = 0;
-                cs = opt.design->shape + east_side[++w];
+                cs = d->shape + east_side[++w];
             }
-            #ifdef DEBUG
-                fprintf (stderr, "\nj %d, k %d, w %d, cs->chars[k] = \"%s\"\n",
-                        j, k, w, cs->chars[k]?cs->chars[k]:"(null)");
-            #endif
-
             chkline.text = cs->chars[k];
             chkline.len = cs->width;
             if (empty_line (&chkline))
                 continue;
+            anz = add_trims (d->east_trims, anz, cs->chars[k], cs->width);
+        }
+        sort_trims (d->east_trims, anz);
+        d->anz_east_trims = anz;
+    }
 
-            s = (char *) strdup (cs->chars[k]);
-            if (s == NULL) {
-                perror (PROJECT);
-                return -1;
-            }
-            cq = cs->width;
+    /*
+     *  Corners. Only the visible part of a corner line is looked for, i.e.
+     *  without leading blanks on the west side and without trailing blanks
+     *  on the east side. Corners next to an empty side are not looked for.
+     */
+    anz = 0;
+    for (c=0; c<ANZ_CORNERS; ++c)
+        anz += d->shape[corners[c]].height;
+    if (anz == 0)
+        return 0;
+    d->corner_trims = (trimmed_t *) malloc (anz * sizeof(trimmed_t));
+    if (d->corner_trims == NULL) {
+        perror (PROJECT);
+        BFREE (d->west_trims);
+        BFREE (d->east_trims);
+        return 1;
+    }
+    t = d->corner_trims;
+    for (c=0; c<ANZ_CORNERS; ++c) {
+        shape_t scnt = corners[c];
+        int     east = scnt == NE || scnt == SE;
 
-            do {
-                p = my_strnrstr (line->text, s, cq, 0);
-                if (p) {
-                    q = p + cq;
-                    while (*q) {
-                        if (*q++ != ' ') {
-                            p = NULL;
-                            break;
-                        }
-                    }
-                    if (p)
-                        break;
+        if (d->metrics.empty[east? BRIG: BLEF]
+                || d->metrics.empty[scnt == NW || scnt == NE? BTOP: BBOT])
+            continue;
+        cs = d->shape + scnt;
+        for (k=0; k<cs->height; ++k) {
+            chkline.text = cs->chars[k];
+            chkline.len = cs->width;
+            if (empty_line (&chkline))
+                continue;
+            t->text = cs->chars[k];
+            t->len = cs->width;
+            t->lead = 0;
+            t->trail = 0;
+            if (east) {
+                while (t->len && (t->text[t->len-1] == ' '
+                            || t->text[t->len-1] == '\t')) {
+                    --(t->len);
+                    ++(t->trail);
                 }
-                if (!p && cq) {
-                    if (*s == ' ')
-                        memmove (s, s+1, cq--);
-                    else if (s[cq-1] == ' ')
-                        s[--cq] = '\0';
-                    else {
-                        cq = 0;
-                        break;
-                    }
+            }
+            else {
+                while (*t->text == ' ' || *t->text == '\t') {
+                    ++(t->text);
+                    --(t->len);
+                    ++(t->lead);
                 }
-            } while (cq && !p);
+            }
+            ++t;
+            ++(d->anz_corner_trims[c]);
+        }
+    }
 
-            if (cq == 0) {
-                BFREE (s);
-                continue;
+    return 0;
+}
+
+
+
+static char *match_west (const line_t *line, const size_t indent,
+        const trimmed_t *t)
+/*
+ *  Check whether the west side variant t matches line. A match must be
+ *  preceded by nothing but spaces, so the position is determined by the
+ *  indentation of the line and the leading spaces of the variant.
+ *  The line is taken to continue with spaces after its end, so trailing
+ *  spaces of the variant need not be present in the line.
+ *
+ *  RETURNS:  != NULL   start of match in line
+ *            == NULL   no match
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t p;
+    size_t n;                            /* number of chars to compare */
+
+    if (t->lead == t->len)               /* blank variant */
+        return indent >= t->len || indent == line->len? line->text: NULL;
+    if (indent < t->lead)
+        return NULL;
+    p = indent - t->lead;
+    n = BMIN (t->len, line->len - p);
+    if (n < t->len - t->trail || memcmp (line->text+p, t->text, n))
+        return NULL;
+    return line->text + p;
+}
+
+
+
+static char *match_east (const line_t *line, const size_t textend,
+        const trimmed_t *t)
+/*
+ *  Check whether the east side variant t matches line. A match must be
+ *  followed by nothing but spaces, so the position is determined by the
+ *  end of the text in line (index after the last non-space character) and
+ *  the trailing spaces of the variant. The trailing spaces need not be
+ *  present in the line, as it is taken to continue with spaces.
+ *
+ *  RETURNS:  != NULL   start of match in line
+ *            == NULL   no match
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t p;
+
+    if (textend < t->len - t->trail)
+        return NULL;
+    p = textend - (t->len - t->trail);
+    if (memcmp (line->text+p, t->text, t->len - t->trail))
+        return NULL;
+    return line->text + p;
+}
+
+
+
+static int best_match (const line_t *line,
+        char **ws, char **we, char **es, char **ee)
+/*
+ *  Find positions of west and east box parts in line.
+ *
+ *  The candidate shape lines and their trimmed variants were computed in
+ *  advance by build_trims(), best first, so the first variant which
+ *  matches is the one to use.
+ *
+ *    line      line to examine
+ *    ws etc.   result parameters (west start, west end, east start, east end)
+ *
+ *  RETURNS:    > 0   a match was found (ws etc are set to indicate positions)
+ *             == 0   no match was found
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const design_t  *d = opt.design;
+    const trimmed_t *t;
+    size_t           indent;         /* number of leading spaces in line */
+    size_t           textend;        /* line length without trailing spaces */
+    size_t           i;
+    char            *p;
+
+    *ws = *we = *es = *ee = NULL;
+
+    /*
+     *  Find match for WEST side
+     */
+    if (d->anz_west_trims > 0) {
+        for (indent=0; indent<line->len && line->text[indent]==' '; ++indent);
+        for (i=0, t=d->west_trims; i<d->anz_west_trims; ++i, ++t) {
+            p = match_west (line, indent, t);
+            if (p) {
+                *ws = p;
+                *we = BMIN (p + t->len, line->text + line->len);
+                break;
             }
+        }
+    }
 
-            /*
-            *  If the current match is the best yet, adjust result values
-            */
-            if (cq > quality) {
-                quality = cq;
+    /*
+     *  Find match for EAST side
+     */
+    if (d->anz_east_trims > 0) {
+        for (textend=line->len; textend>0 && line->text[textend-1]==' ';
+                --textend);
+        for (i=0, t=d->east_trims; i<d->anz_east_trims; ++i, ++t) {
+            p = match_east (line, textend, t);
+            if (p) {
                 *es = p;
-                *ee = p + cq;
+                *ee = BMIN (p + t->len, line->text + line->len);
+                break;
             }
-
-            BFREE (s);
         }
     }
 
@@ -225,17 +383,24 @@ static int best_match (const line_t *line,
 
 
 static int hmm (const int aside, const size_t follow,
-        const char *p, const char *ecs, const int cnt)
+        const char *p, const char *ecs, char *ok)
 /*
  *  (horizontal middle match)
  *
  *      aside   box part to check (BTOP or BBOT)
  *      follow  index of line number in shape spec to check
- *      p       current check position
+ *      p       start of text between the corner shapes
  *      ecs     pointer to first char of east corner shape
- *      cnt     current shape to check (0 == leftmost middle shape)
+ *      ok      work space of at least (ecs-p) * (SHAPES_PER_SIDE-2) chars
+ *
+ *  Helper function for detect_horiz(). Checks if the text from p to ecs
+ *  consists of the middle shapes of the box side in order, each of them
+ *  used once, elastic ones possibly repeated.
  *
- *  Recursive helper function for detect_horiz(), uses backtracking
+ *  Dynamic programming from right to left: ok[pos*anz+c] is true if the
+ *  text from position pos can be matched starting with middle shape c.
+ *  This takes O((ecs-p) * anz) shape comparisons, whereas simple
+ *  backtracking can take exponential time on wide boxes.
  *
  *  RETURNS:  == 0  success
  *            != 0  error
@@ -243,69 +408,130 @@ static int hmm (const int aside, const size_t follow,
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    int       cmp;
-    sentry_t *cs;
+    sentry_t *cs[SHAPES_PER_SIDE];       /* middle shapes, leftmost first */
+    size_t    anz;                       /* number of middle shapes */
+    size_t    len;                       /* length of text to match */
+    size_t    pos;                       /* current check position */
+    size_t    np;                        /* position after current shape */
+    size_t    c;                         /* current shape */
     shape_t   sh;
-    int       rc;
+    char      r;
 
     #ifdef DEBUG
-        fprintf (stderr, "hmm (%s, %d, \'%c\', \'%c\', %d)\n",
-                aside==BTOP?"BTOP":"BBOT", follow, p[0], *ecs, cnt);
+        fprintf (stderr, "hmm (%s, %d, \'%c\', \'%c\')\n",
+                aside==BTOP?"BTOP":"BBOT", follow, p[0], *ecs);
     #endif
 
-    if (p > ecs)                         /* last shape tried was too long */
-        return 2;
-
-    sh = leftmost (aside, cnt);
-    if (sh == ANZ_SHAPES)
+    if (p >= ecs)
+        return 1;
+    for (anz=0; anz<SHAPES_PER_SIDE-2; ++anz) {
+        sh = leftmost (aside, anz);
+        if (sh == ANZ_SHAPES)
+            break;
+        cs[anz] = opt.design->shape + sh;
+    }
+    if (anz == 0)
         return 1;
 
-    cs = opt.design->shape + sh;
-
-    cmp = strncmp (p, cs->chars[follow], cs->width);
-
-    if (cmp == 0) {
-        if (p+cs->width == ecs) {
-            if (leftmost (aside, cnt+1) == ANZ_SHAPES)
-                return 0;                /* good! all clear, it matched */
-            else
-                return 3;                /* didn't use all shapes to do it */
-        }
-        if (cs->elastic) {
-            rc = hmm (aside, follow, p+cs->width, ecs, cnt);
-            #ifdef DEBUG
-                fprintf (stderr, "hmm returned %d\n", rc);
-            #endif
-            if (rc) {
-                rc = hmm (aside, follow, p+cs->width, ecs, cnt+1);
-                #ifdef DEBUG
-                    fprintf (stderr, "hmm returned %d\n", rc);
-                #endif
+    len = ecs - p;
+    for (pos=len; pos-- > 0; ) {
+        for (c=0; c<anz; ++c) {
+            r = 0;
+            np = pos + cs[c]->width;
+            if (np <= len
+                    && !strncmp (p+pos, cs[c]->chars[follow], cs[c]->width))
+            {
+                if (np == len)
+                    r = (c == anz-1);    /* all shapes used? */
+                else {
+                    if (cs[c]->elastic)
+                        r = ok[np*anz+c];
+                    if (!r && c+1 < anz)
+                        r = ok[np*anz+c+1];
+                }
             }
+            ok[pos*anz+c] = r;
         }
-        else {
-            rc = hmm (aside, follow, p+cs->width, ecs, cnt+1);
-            #ifdef DEBUG
-                fprintf (stderr, "hmm returned %d\n", rc);
-            #endif
-        }
-        if (rc == 0)
-            return 0;                    /* we're on the way back */
-        else
-            return 4;                    /* can't continue on this path */
     }
-    else {
-        return 5;                        /* no match */
+
+    return ok[0]? 0: 1;
+}
+
+
+
+typedef struct {                         /* work space of detect_horiz() */
+    char   *ok;                          /* for hmm() */
+    line_t  line;                        /* padded copy of an input line */
+    size_t  size;                        /* size of line.text */
+} scratch_t;
+
+
+
+static int alloc_scratch (scratch_t *s)
+/*
+ *  Allocate the work space of detect_horiz() for the current design and
+ *  input. This is done once by the callers, which may call detect_horiz()
+ *  for many lines, instead of for every call. Free with free_scratch().
+ *
+ *  RETURNS:  == 0  success
+ *            != 0  error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    s->size = input.maxline + BMAX (opt.design->shape[NW].width,
+            opt.design->shape[NE].width) + 1;
+    s->ok = (char *) malloc (s->size * (SHAPES_PER_SIDE-2));
+    s->line.text = (char *) malloc (s->size);
+    if (s->ok == NULL || s->line.text == NULL) {
+        perror (PROJECT);
+        BFREE (s->ok);
+        BFREE (s->line.text);
+        return 1;
+    }
+    return 0;
+}
+
+
+
+static void free_scratch (scratch_t *s)
+{
+    BFREE (s->ok);
+    BFREE (s->line.text);
+}
+
+
+
+static size_t pad_width (const sentry_t *cs, const size_t follow)
+/*
+ *  Return how many spaces must be appended to an input line, so that a box
+ *  line whose trailing spaces were removed may be matched, if its east
+ *  corner is cs. If the corner line has a character other than a space,
+ *  the corner must end at most its width after the end of the input line.
+ *  Otherwise, the box line may end anywhere, and is padded to the length
+ *  of the longest line.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t k;
+
+    for (k=0; k<cs->width; ++k) {
+        if (cs->chars[follow][k] != ' ')
+            return BMAX (opt.design->shape[NW].width, cs->width);
     }
+    return 0;
 }
 
 
 
-static int detect_horiz (const int aside, size_t *hstart, size_t *hend)
+static int detect_horiz (const int aside, scratch_t *scratch,
+                         size_t *hstart, size_t *hend)
 /*
  *  Detect which part of the input belongs to the top/bottom of the box
  *
  *      aside   part of box to detect (BTOP or BBOT)
+ *      scratch work space from alloc_scratch()
  *      hstart  index of first line of detected box part (result)
  *      hend    index of first line following detected box part (result)
  *
@@ -325,7 +551,9 @@ static int detect_horiz (const int aside, size_t *hstart, size_t *hend)
 {
     size_t    follow;                    /* possible box line */
     sentry_t *cs;                        /* current shape */
-    line_t   *line;                      /* currently processed input line */
+    line_t   *src;                       /* currently processed input line */
+    line_t   *line = &(scratch->line);   /* src plus trailing spaces */
+    size_t    epad;                      /* number of spaces to append */
     size_t    lcnt;                      /* line counter */
     char     *p = NULL;                  /* middle line part scanner */
     char     *q;                         /* space check rover */
@@ -339,23 +567,37 @@ static int detect_horiz (const int aside, size_t *hstart, size_t *hend)
     int       gowest;                    /* set to request search start incr. */
 
     *hstart = *hend = 0;
-    nowside = empty_side (opt.design->shape, BLEF);
+    nowside = opt.design->metrics.empty[BLEF];
 
     mheight = opt.design->shape[sides[aside][0]].height;
     if (aside == BTOP) {
         follow = 0;
-        line=input.lines;
+        src = input.lines;
     }
     else {
         follow = mheight - 1;
-        line = input.lines + input.anz_lines - 1;
+        src = input.lines + input.anz_lines - 1;
     }
 
     for (lcnt=0; lcnt<mheight && lcnt<input.anz_lines
-            && line >= input.lines; ++lcnt)
+            && src >= input.lines; ++lcnt)
     {
         goeast = gowest = 0;
 
+        /*
+         *  Input lines are not padded, so spaces at the end of the box line
+         *  may be missing. Scan a copy padded as far as the box may reach.
+         */
+        cs = opt.design->shape + sides[aside][aside==BTOP?SHAPES_PER_SIDE-1:0];
+        epad = pad_width (cs, follow);
+        if (epad)
+            line->len = src->len + epad;
+        else
+            line->len = input.maxline + cs->width;
+        memcpy (line->text, src->text, src->len);
+        memset (line->text + src->len, ' ', line->len - src->len);
+        line->text[line->len] = '\0';
+
         #ifdef DEBUG
             fprintf (stderr, "----- Processing line index %2d ----------"
                     "-------------------------------------\n",
@@ -444,7 +686,7 @@ static int detect_horiz (const int aside, size_t *hstart, size_t *hend)
             /*
              *  Check if text between corner shapes is valid
              */
-            mmok = !hmm (aside, follow, p, ecs, 0);
+            mmok = !hmm (aside, follow, p, ecs, scratch->ok);
             if (!mmok)
                 ++goeast;
             #ifdef DEBUG
@@ -482,11 +724,11 @@ static int detect_horiz (const int aside, size_t *hstart, size_t *hend)
 
         if (aside == BTOP) {
             ++follow;
-            ++line;
+            ++src;
         }
         else {
             --follow;
-            --line;
+            --src;
         }
     }
 
@@ -495,264 +737,389 @@ static int detect_horiz (const int aside, size_t *hstart, size_t *hend)
 
 
 
-static design_t *detect_design()
+static int side_defined (const design_t *d, const shape_t first, const shape_t last)
 /*
- *  Autodetect design used by box in input.
+ *  Return true if any of the shapes first to last of design d is defined.
  *
- *  This requires knowledge about ALL designs, so the entire config file had
- *  to be parsed at some earlier time.
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    shape_t scnt;
+
+    for (scnt=first; scnt<=last; ++scnt) {
+        if (!isempty (d->shape + scnt))
+            return 1;
+    }
+    return 0;
+}
+
+
+
+static long score_ends (const design_t *d)
+/*
+ *  Score the corners and the top and bottom sides of design d against the
+ *  box in input. Only the first and last lines of the input are looked at.
  *
- *  RETURNS:  != NULL   success, pointer to detected design
- *            == NULL   on error
+ *    d       design to score
+ *
+ *  RETURNS:  number of hits
  *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    design_t *d = designs;               /* ptr to currently tested design */
-    long      hits;                      /* hit points of the current design */
-    long      maxhits = 0;               /* maximum no. of hits so far */
-    design_t *res = NULL;                /* ptr to design with the most hits */
-    int       dcnt;                      /* design loop counter */
+    const int *empty = d->metrics.empty;
+    long      hits = 0;
     shape_t   scnt;                      /* shape loop counter */
     size_t    j, k;
     char     *p;
-    char     *s;
     line_t    shpln;                     /* a line which is part of a shape */
     size_t    a;
-    int       empty[ANZ_SIDES];
+    size_t    height;                    /* of current corner */
+    int       c;
+    const trimmed_t *r;
+    const trimmed_t *t = d->corner_trims;
 
-    for (dcnt=0; dcnt<anz_designs; ++dcnt, ++d) {
+    /*
+     *  Try and find corner shapes. Every non-empty shape line is searched
+     *  for on every input line. A hit is generated whenever a match is
+     *  found.
+     */
+    for (c=0; c<ANZ_CORNERS; ++c) {
+        scnt = corners[c];
+        height = d->shape[scnt].height;
+        for (r=t; r<t+d->anz_corner_trims[c]; ++r) {
+            for (k=0; k<height; ++k) {
+                a = k;
+                if (scnt == SW || scnt == SE)
+                    a += input.anz_lines - height;
+                if (a >= input.anz_lines)
+                    break;
+                if (scnt == NW || scnt == SW) {
+                    for (p=input.lines[a].text; *p==' '||*p=='\t'; ++p);
+                }
+                else {
+                    for (p=input.lines[a].text + input.lines[a].len -1;
+                            p>=input.lines[a].text && (*p==' ' || *p=='\t');
+                            --p);
+                    p = p - r->len + 1;
+                    if (p < input.lines[a].text)
+                        continue;
+                }
+                if (strncmp (p, r->text, r->len) == 0)
+                    ++hits;
+            }
+        }
+        t += d->anz_corner_trims[c];
         #ifdef DEBUG
-            fprintf (stderr, "CONSIDERING DESIGN ---- \"%s\" ---------------\n",
-                    d->name);
+            fprintf (stderr, "After %s corner check:\t%ld hits.\n",
+                    shape_name[scnt], hits);
         #endif
-        hits = 0;
+    }
 
-        for (j=0; j<ANZ_SIDES; ++j)
-            empty[j] = empty_side (d->shape, j);
+    /*
+     *  Try and find horizontal shapes between the box corners. Every
+     *  non-empty shape line is searched for on every input line. Elastic
+     *  shapes must occur twice in an uninterrupted row to generate a hit.
+     */
+    for (scnt=0; scnt<ANZ_SHAPES; ++scnt) {
+        if (!((scnt >= NNW && scnt <= NNE) || (scnt >= SSE && scnt <= SSW)))
+            continue;
+        if (isempty (d->shape+scnt))
+            continue;
+        if ((scnt >= NNW && scnt <= NNE && empty[BTOP])
+                || (scnt >= SSE && scnt <= SSW && empty[BBOT])) {
+            ++hits;
+            continue;                    /* horizontal box part is empty */
+        }
+        for (j=0; j<d->shape[scnt].height; ++j) {
+            shpln.text = d->shape[scnt].chars[j];
+            shpln.len = d->shape[scnt].width;
+            if (empty_line (&shpln))
+                continue;
+            for (k=0; k<d->shape[scnt].height; ++k) {
+                a = k;
+                if (scnt >= SSE && scnt <= SSW)
+                    a += input.anz_lines-d->shape[scnt].height;
+                if (a >= input.anz_lines)
+                    break;
+                for (p=input.lines[a].text;
+                        *p == ' ' || *p == '\t'; ++p);
+                p += d->shape[NW].width;
+                if (p-input.lines[a].text
+                        >= (long) input.lines[a].len)
+                    continue;
+                p = strstr (p, shpln.text);
+                if (p) {
+                    if (d->shape[scnt].elastic) {
+                        p += shpln.len;
+                        if (p-input.lines[a].text
+                                >= (long) input.lines[a].len)
+                            continue;
+                        if (!strncmp (p, shpln.text, shpln.len))
+                            ++hits;
+                    }
+                    else {
+                        ++hits;
+                    }
+                }
+            }
+        }
         #ifdef DEBUG
-            fprintf (stderr, "Empty sides: TOP %d, LEFT %d, BOTTOM %d, RIGHT %d\n",
-                    empty[BTOP], empty[BLEF], empty[BBOT], empty[BRIG]);
+            fprintf (stderr, "After %s shape check:\t%ld hits.\n",
+                    shape_name[scnt], hits);
         #endif
+    }
 
-        for (scnt=0; scnt<ANZ_SHAPES; ++scnt) {
-
-            switch (scnt) {
-                case NW: case SW:
-                    /*
-                     *  Try and find west corner shapes. Every non-empty shape
-                     *  line is searched for on every input line. A hit is
-                     *  generated whenever a match is found.
-                     */
-                    if (empty[BLEF] || (empty[BTOP] && scnt == NW)
-                            || (empty[BBOT] && scnt == SW))
-                        break;
-                    for (j=0; j<d->shape[scnt].height; ++j) {
-                        shpln.text = d->shape[scnt].chars[j];
-                        shpln.len = d->shape[scnt].width;
-                        if (empty_line (&shpln))
-                            continue;
-                        for (s=shpln.text; *s==' ' || *s=='\t'; ++s);
-                        for (k=0; k<d->shape[scnt].height; ++k) {
-                            a = k;
-                            if (scnt == SW)
-                                a += input.anz_lines - d->shape[scnt].height;
-                            if (a >= input.anz_lines)
-                                break;
-                            for (p=input.lines[a].text; *p==' '||*p=='\t'; ++p);
-                            if (strncmp (p, s, shpln.len-(s-shpln.text)) == 0)
-                                ++hits;
-                        }
-                    }
-                    #ifdef DEBUG
-                        fprintf (stderr, "After %s corner check:\t%ld hits.\n",
-                                shape_name[scnt], hits);
-                    #endif
-                    break;
-
-                case NE: case SE:
-                    /*
-                     *  Try and find east corner shapes. Every non-empty shape
-                     *  line is searched for on every input line. A hit is
-                     *  generated whenever a match is found.
-                     */
-                    if (empty[BRIG] || (empty[BTOP] && scnt == NE)
-                            || (empty[BBOT] && scnt == SE))
-                        break;
-                    for (j=0; j<d->shape[scnt].height; ++j) {
-                        shpln.text = d->shape[scnt].chars[j];
-                        shpln.len = d->shape[scnt].width;
-                        if (empty_line (&shpln))
-                            continue;
-                        for (s = shpln.text + shpln.len -1;
-                                (*s==' ' || *s=='\t') && shpln.len;
-                                --s, --(shpln.len));
-                        for (k=0; k<d->shape[scnt].height; ++k) {
-                            a = k;
-                            if (scnt == SE)
-                                a += input.anz_lines - d->shape[scnt].height;
-                            if (a >= input.anz_lines)
-                                break;
-                            for (p=input.lines[a].text + input.lines[a].len -1;
-                                    p>=input.lines[a].text && (*p==' ' || *p=='\t');
-                                    --p);
-                            p = p - shpln.len + 1;
-                            if (p < input.lines[a].text)
-                                continue;
-                            if (strncmp (p, shpln.text, shpln.len) == 0)
-                                ++hits;
-                        }
-                    }
-                    #ifdef DEBUG
-                        fprintf (stderr, "After %s corner check:\t%ld hits.\n",
-                                shape_name[scnt], hits);
-                    #endif
-                    break;
+    return hits;
+}
 
-                default:
-                    if (isempty (d->shape+scnt))
-                        continue;
 
-                    if ((scnt >= NNW && scnt <= NNE)
-                            || (scnt >= SSE && scnt <= SSW)) {
-                        /*
-                         *  Try and find horizontal shapes between the box
-                         *  corners. Every non-empty shape line is searched for
-                         *  on every input line. Elastic shapes must occur
-                         *  twice in an uninterrupted row to generate a hit.
-                         */
-                        if ((scnt >= NNW && scnt <= NNE && empty[BTOP])
-                              || (scnt >= SSE && scnt <= SSW && empty[BBOT])) {
-                            ++hits;
-                            break;       /* horizontal box part is empty */
-                        }
-                        for (j=0; j<d->shape[scnt].height; ++j) {
-                            shpln.text = d->shape[scnt].chars[j];
-                            shpln.len = d->shape[scnt].width;
-                            if (empty_line (&shpln))
-                                continue;
-                            for (k=0; k<d->shape[scnt].height; ++k) {
-                                a = k;
-                                if (scnt >= SSE && scnt <= SSW)
-                                    a += input.anz_lines-d->shape[scnt].height;
-                                if (a >= input.anz_lines)
-                                    break;
-                                for (p=input.lines[a].text;
-                                        *p == ' ' || *p == '\t'; ++p);
-                                p += d->shape[NW].width;
-                                if (p-input.lines[a].text
-                                        >= (long) input.lines[a].len)
-                                    continue;
-                                p = strstr (p, shpln.text);
-                                if (p) {
-                                    if (d->shape[scnt].elastic) {
-                                        p += shpln.len;
-                                        if (p-input.lines[a].text
-                                                >= (long) input.lines[a].len)
-                                            continue;
-                                        if (!strncmp (p, shpln.text, shpln.len))
-                                            ++hits;
-                                    }
-                                    else {
-                                        ++hits;
-                                    }
-                                }
-                            }
-                        }
-                    }
 
-                    else if ((scnt >= ENE && scnt <= ESE)
-                            || (scnt >= WSW && scnt <= WNW)) {
-                        /* handle later */
-                        break;
-                    }
-                    else {
-                        fprintf (stderr, "%s: internal error\n", PROJECT);
-                        return NULL;
-                    }
-                    #ifdef DEBUG
-                        fprintf (stderr, "After %s shape check:\t%ld hits.\n",
-                                shape_name[scnt], hits);
-                    #endif
-            }
-        }
+static long score_body (const design_t *d)
+/*
+ *  Score the west and east sides of design d against the box in input.
+ *  Every input line except for potential top and bottom box parts is
+ *  looked at.
+ *
+ *    d       design to score
+ *
+ *  RETURNS:  number of hits
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const int *empty = d->metrics.empty;
+    long      hits = 0;
+    shape_t   scnt;                      /* shape loop counter */
+    size_t    j, k;
+    char     *p;
+    char     *s;
+    line_t    shpln;                     /* a line which is part of a shape */
+    size_t    a;
 
-        /*
-         *  Now iterate over all input lines except for potential top and
-         *  bottom box parts. Check if east and west line ends match a
-         *  non-empty shape line. If so, generate a hit.
-         */
-        if (((empty[BTOP]? 0: d->shape[NW].height)
-                    + (empty[BBOT]? 0: d->shape[SW].height)) < input.anz_lines)
+    /*
+     *  Now iterate over all input lines except for potential top and
+     *  bottom box parts. Check if east and west line ends match a
+     *  non-empty shape line. If so, generate a hit.
+     */
+    if (((empty[BTOP]? 0: d->shape[NW].height)
+                + (empty[BBOT]? 0: d->shape[SW].height)) < input.anz_lines)
+    {
+        for (k = empty[BTOP]? 0: d->shape[NW].height;
+                k < input.anz_lines -(empty[BBOT]? 0: d->shape[SW].height);
+                ++k)
         {
-            for (k = empty[BTOP]? 0: d->shape[NW].height;
-                    k < input.anz_lines -(empty[BBOT]? 0: d->shape[SW].height);
-                    ++k)
-            {
-                for (p=input.lines[k].text; *p==' ' || *p=='\t'; ++p);
-                for (scnt=WSW; scnt<=WNW; ++scnt) {
-                    a = 0;
-                    if (isempty (d->shape + scnt))
+            for (p=input.lines[k].text; *p==' ' || *p=='\t'; ++p);
+            for (scnt=WSW; scnt<=WNW; ++scnt) {
+                a = 0;
+                if (isempty (d->shape + scnt))
+                    continue;
+                for (j=0; j<d->shape[scnt].height; ++j) {
+                    shpln.text = d->shape[scnt].chars[j];
+                    shpln.len = d->shape[scnt].width;
+                    if (empty_line (&shpln))
                         continue;
-                    for (j=0; j<d->shape[scnt].height; ++j) {
-                        shpln.text = d->shape[scnt].chars[j];
-                        shpln.len = d->shape[scnt].width;
-                        if (empty_line (&shpln))
-                            continue;
-                        for (s=shpln.text; *s==' ' || *s=='\t'; ++s);
-                        if (strncmp (p, s, shpln.len-(s-shpln.text)) == 0) {
-                            ++hits;
-                            a = 1;
-                            break;
-                        }
-                    }
-                    if (a)
+                    for (s=shpln.text; *s==' ' || *s=='\t'; ++s);
+                    if (strncmp (p, s, shpln.len-(s-shpln.text)) == 0) {
+                        ++hits;
+                        a = 1;
                         break;
+                    }
                 }
+                if (a)
+                    break;
+            }
 
-                for (scnt=ENE; scnt<=ESE; ++scnt) {
-                    a = 0;
-                    if (isempty (d->shape + scnt))
+            for (scnt=ENE; scnt<=ESE; ++scnt) {
+                a = 0;
+                if (isempty (d->shape + scnt))
+                    continue;
+                for (j=0; j<d->shape[scnt].height; ++j) {
+                    shpln.text = d->shape[scnt].chars[j];
+                    shpln.len = d->shape[scnt].width;
+                    if (empty_line (&shpln))
                         continue;
-                    for (j=0; j<d->shape[scnt].height; ++j) {
-                        shpln.text = d->shape[scnt].chars[j];
-                        shpln.len = d->shape[scnt].width;
-                        if (empty_line (&shpln))
-                            continue;
-                        for (p=input.lines[k].text + input.lines[k].len -1;
-                                p>=input.lines[a].text && (*p==' ' || *p=='\t');
-                                --p);
-                        for (s = shpln.text + shpln.len -1;
-                                (*s==' ' || *s=='\t') && shpln.len;
-                                --s, --(shpln.len));
-                        p = p - shpln.len + 1;
-                        if (strncmp (p, shpln.text, shpln.len) == 0) {
-                            ++hits;
-                            a = 1;
-                            break;
-                        }
-                    }
-                    if (a)
+                    for (p=input.lines[k].text + input.lines[k].len -1;
+                            p>=input.lines[k].text && (*p==' ' || *p=='\t');
+                            --p);
+                    for (s = shpln.text + shpln.len -1;
+                            (*s==' ' || *s=='\t') && shpln.len;
+                            --s, --(shpln.len));
+                    p = p - shpln.len + 1;
+                    if (p < input.lines[k].text)
+                        continue;
+                    if (strncmp (p, shpln.text, shpln.len) == 0) {
+                        ++hits;
+                        a = 1;
                         break;
+                    }
                 }
+                if (a)
+                    break;
             }
         }
+    }
+
+    return hits;
+}
+
+
+
+static long max_body_hits (const design_t *d)
+/*
+ *  Return the highest score score_body() can possibly give for design d,
+ *  which is one hit per side and body line.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const int *empty = d->metrics.empty;
+    size_t     vert;
+    long       sides;
+
+    vert = (empty[BTOP]? 0: d->shape[NW].height)
+        + (empty[BBOT]? 0: d->shape[SW].height);
+    if (vert >= input.anz_lines)
+        return 0;
+    sides = side_defined (d, WSW, WNW) + side_defined (d, ENE, ESE);
+    return sides * (long) (input.anz_lines - vert);
+}
+
+
+
+typedef struct {
+    design_t *d;
+    long      hits;                      /* hits scored so far */
+    long      bound;                     /* max. hits d can possibly score */
+    int       scored;                    /* true if hits is the full score */
+} candidate_t;
+
+
+
+static int candidate_cmp (const void *p1, const void *p2)
+/*
+ *  qsort() callback: Most promising candidates first, config file order
+ *  among equally promising ones.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const candidate_t *c1 = (const candidate_t *) p1;
+    const candidate_t *c2 = (const candidate_t *) p2;
+
+    if (c1->bound != c2->bound)
+        return c1->bound > c2->bound? -1: 1;
+    if (c1->d != c2->d)
+        return c1->d < c2->d? -1: 1;
+    return 0;
+}
+
+
+
+design_t *detect_design (long *margin)
+/*
+ *  Autodetect design used by box in input.
+ *
+ *  This requires knowledge about ALL designs, so the entire config file had
+ *  to be parsed at some earlier time.
+ *
+ *  The design with the most hits wins, the first one in the config file if
+ *  there is a tie. The top and bottom of the box are scored for all designs
+ *  first, which is cheap and yields an upper bound for the total score of
+ *  each design. The box body is then only scored for designs which can
+ *  still win, the most promising first. Detection stops as soon as the
+ *  leading design has reached opt.certainty percent of its upper bound.
+ *
+ *    margin   RESULT: by how many hits the detected design beats all other
+ *             designs. Designs which were not scored in full count with
+ *             their upper bound, so this is a lower limit. 0 means that
+ *             the detection is ambiguous.
+ *
+ *  RETURNS:  != NULL   success, pointer to detected design
+ *            == NULL   on error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    candidate_t *cand;                   /* one entry per design */
+    candidate_t *c;
+    candidate_t *best = NULL;            /* candidate with the most hits */
+    long         maxhits = 0;            /* maximum no. of hits so far */
+    long         runnerup = 0;           /* max. hits of any other design */
+    design_t    *res;
+    int          dcnt;                   /* design loop counter */
+
+    *margin = 0;
+    if (anz_designs <= 0)
+        return NULL;
+    cand = (candidate_t *) calloc (anz_designs, sizeof(candidate_t));
+    if (cand == NULL) {
+        perror (PROJECT);
+        return NULL;
+    }
+
+    for (dcnt=0, c=cand; dcnt<anz_designs; ++dcnt, ++c) {
+        c->d = designs + dcnt;
+        c->hits = score_ends (c->d);
+        c->bound = c->hits + max_body_hits (c->d);
+    }
+    qsort (cand, anz_designs, sizeof(candidate_t), candidate_cmp);
+
+    for (dcnt=0, c=cand; dcnt<anz_designs; ++dcnt, ++c) {
+        #ifdef DEBUG
+            fprintf (stderr, "CONSIDERING DESIGN ---- \"%s\" ---------------\n",
+                    c->d->name);
+            fprintf (stderr, "Empty sides: TOP %d, LEFT %d, BOTTOM %d, RIGHT %d\n",
+                    c->d->metrics.empty[BTOP], c->d->metrics.empty[BLEF],
+                    c->d->metrics.empty[BBOT], c->d->metrics.empty[BRIG]);
+            fprintf (stderr, "Top and bottom:\t%ld hits, at most %ld in total.\n",
+                    c->hits, c->bound);
+        #endif
+        if (c->bound < maxhits || (best && c->bound == maxhits && c->d > best->d)) {
+            #ifdef DEBUG
+                fprintf (stderr, "Cannot beat \"%s\", stopping.\n", best->d->name);
+            #endif
+            break;                       /* neither can any of the rest */
+        }
+
+        c->hits += score_body (c->d);
+        c->scored = 1;
         #ifdef DEBUG
-            fprintf (stderr, "After side checks:\t%ld hits.\n", hits);
+            fprintf (stderr, "After side checks:\t%ld hits.\n", c->hits);
         #endif
 
-        if (hits > maxhits) {
-            maxhits = hits;
-            res = d;
+        if (c->hits > maxhits || (best && c->hits == maxhits && c->d < best->d)) {
+            maxhits = c->hits;
+            best = c;
+            if (maxhits * 100 >= (long) opt.certainty * c->bound) {
+                #ifdef DEBUG
+                    fprintf (stderr, "Certainty of %d%% reached, stopping.\n",
+                            opt.certainty);
+                #endif
+                break;
+            }
         }
     }
 
-    #ifdef DEBUG
-        if (res)
-            fprintf (stderr, "CHOOSING \"%s\" design (%ld hits).\n",
-                    res->name, maxhits);
-        else
+    if (best == NULL) {
+        #ifdef DEBUG
             fprintf (stderr, "NO DESIGN FOUND WITH EVEN ONE HIT!\n");
+        #endif
+        BFREE (cand);
+        return NULL;
+    }
+
+    for (dcnt=0, c=cand; dcnt<anz_designs; ++dcnt, ++c) {
+        if (c != best)
+            runnerup = BMAX (runnerup, c->scored? c->hits: c->bound);
+    }
+    *margin = BMAX (maxhits - runnerup, 0);
+    res = best->d;
+    BFREE (cand);
+
+    #ifdef DEBUG
+        fprintf (stderr, "CHOOSING \"%s\" design (%ld hits, margin %ld).\n",
+                res->name, maxhits, *margin);
     #endif
 
     return res;
@@ -760,9 +1127,89 @@ static design_t *detect_design()
 
 
 
-int remove_box()
+static int match_horiz (const int aside, const size_t lidx, scratch_t *scratch)
 /*
- *  Remove box from input.
+ *  Check whether a complete top or bottom side of the box starts at input
+ *  line lidx.
+ *
+ *      aside   box part to check (BTOP or BBOT)
+ *      lidx    index of input line to check
+ *      scratch work space from alloc_scratch()
+ *
+ *  RETURNS:  != 0  the box part was found
+ *            == 0  no match
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    input_t whole = input;
+    size_t  height = opt.design->shape[sides[aside][0]].height;
+    size_t  hstart, hend;
+    int     rc;
+
+    if (lidx + height > input.anz_lines)
+        return 0;
+
+    input.lines += lidx;
+    input.anz_lines = height;
+    rc = detect_horiz (aside, scratch, &hstart, &hend);
+    input = whole;
+
+    return rc == 0 && hstart == 0 && hend == height;
+}
+
+
+
+static int fits_box (design_t *d)
+/*
+ *  Check whether the input is a box of design d, i.e. starts with the top
+ *  side of the box, ends with its bottom side, and has the west and east
+ *  sides on every line in between. This is used to verify a design taken
+ *  from the autodetection cache, which only knows the first and last line.
+ *
+ *  RETURNS:  != 0  the box may be of design d
+ *            == 0  the box is not of design d
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    design_t *saved_design = opt.design;
+    size_t    top = 0;                   /* first line of box body */
+    size_t    bottom = input.anz_lines;  /* first line after box body */
+    size_t    j;
+    char     *ws, *we, *es, *ee;
+    scratch_t scratch;
+    int       rc = 1;
+
+    opt.design = d;
+    if (alloc_scratch (&scratch)) {
+        opt.design = saved_design;
+        return 0;
+    }
+    if (!d->metrics.empty[BTOP]) {
+        top = d->shape[NW].height;
+        rc = match_horiz (BTOP, 0, &scratch);
+    }
+    if (rc && !d->metrics.empty[BBOT]) {
+        rc = input.anz_lines >= top + d->shape[SW].height
+            && match_horiz (BBOT, input.anz_lines - d->shape[SW].height, &scratch);
+        bottom = input.anz_lines - d->shape[SW].height;
+    }
+    free_scratch (&scratch);
+    for (j=top; rc && j<bottom; ++j) {
+        best_match (input.lines + j, &ws, &we, &es, &ee);
+        rc = (ws || d->anz_west_trims == 0) && (es || d->anz_east_trims == 0);
+    }
+    opt.design = saved_design;
+
+    return rc;
+}
+
+
+
+int prepare_removal()
+/*
+ *  Get ready to remove boxes from input: Select the design to remove.
  *
  *  RETURNS:  == 0  success
  *            != 0  error
@@ -770,21 +1217,25 @@ int remove_box()
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    size_t textstart = 0;            /* index of 1st line of box body */
-    size_t textend = 0;              /* index of 1st line of south side */
-    size_t boxstart = 0;             /* index of 1st line of box */
-    size_t boxend = 0;               /* index of 1st line trailing the box */
-    int    m;                        /* true if a match was found */
-    size_t j;                        /* loop counter */
-    int    did_something = 0;        /* true if there was something to remove */
-
     /*
      *  If the user didn't specify a design to remove, autodetect it.
      *  Since this requires knowledge of all available designs, the entire
-     *  config file had to be parsed (earlier).
+     *  config file had to be parsed (earlier). A design found in the cache
+     *  saves the detection, but only if the box still fits it. Only designs
+     *  which fit the box and were detected unambiguously are put in the
+     *  cache.
      */
     if (opt.design_choice_by_user == 0) {
-        design_t *tmp = detect_design();
+        int       cached = cache_enabled();
+        design_t *tmp = cached? cache_lookup(): NULL;
+        long      margin;
+        if (tmp && !fits_box (tmp))
+            tmp = NULL;
+        if (tmp == NULL) {
+            tmp = detect_design (&margin);
+            if (cached && tmp && margin > 0 && fits_box (tmp))
+                cache_store (tmp);
+        }
         if (tmp) {
             opt.design = tmp;
             #ifdef DEBUG
@@ -799,27 +1250,56 @@ int remove_box()
         }
     }
 
-    /*
-     *  Make all lines the same length by adding trailing spaces (needed
-     *  for recognition).
-     *  Also append a number of spaces to ALL input lines. A greater number
-     *  takes more space and time, but enables the correct removal of boxes
-     *  whose east sides consist of lots of spaces (the given value). So we
-     *  add a number of spaces equal to the east side width.
-     */
-    input.maxline += opt.design->shape[NE].width;
+    return 0;
+}
+
+
+
+static void note_padding (const size_t width)
+/*
+ *  Record for each input line how many trailing spaces it lacks to be
+ *  width characters long.
+ *
+ *  Lines are matched without padding them (see match_east()), but
+ *  reversion rules may depend on the trailing spaces which removal used to
+ *  leave behind. The spaces are only added to a line while the reversion
+ *  rules are applied to it (see apply_substitutions()).
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t j;
+
     for (j=0; j<input.anz_lines; ++j) {
-        input.lines[j].text = (char *)
-            realloc (input.lines[j].text, input.maxline+1);
-        if (input.lines[j].text == NULL) {
-            perror (PROJECT);
-            return 1;
-        }
-        memset (input.lines[j].text + input.lines[j].len, ' ',
-                input.maxline - input.lines[j].len);
-        input.lines[j].text[input.maxline] = '\0';
-        input.lines[j].len = input.maxline;
+        if (input.lines[j].len < width)
+            input.lines[j].padding = width - input.lines[j].len;
     }
+}
+
+
+
+int strip_box()
+/*
+ *  Remove the box of the current design from input. The input is assumed
+ *  to consist of that box only, plus some lines before or after it.
+ *
+ *  RETURNS:  == 0  success
+ *            != 0  error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t textstart = 0;            /* index of 1st line of box body */
+    size_t textend = 0;              /* index of 1st line of south side */
+    size_t boxstart = 0;             /* index of 1st line of box */
+    size_t boxend = 0;               /* index of 1st line trailing the box */
+    int    m;                        /* true if a match was found */
+    size_t j;                        /* loop counter */
+    int    did_something = 0;        /* true if there was something to remove */
+    scratch_t scratch;               /* work space of detect_horiz() */
+
+    if (alloc_scratch (&scratch))
+        return 1;
 
     /*
      *  Debugging Code: Display contents of input structure
@@ -838,13 +1318,13 @@ int remove_box()
      */
     boxstart = 0;
     textstart = 0;
-    if (empty_side (opt.design->shape, BTOP)) {
+    if (opt.design->metrics.empty[BTOP]) {
         #ifdef DEBUG
             fprintf (stderr, "----> Top box side is empty: boxstart == textstart == 0.\n");
         #endif
     }
     else {
-        detect_horiz (BTOP, &boxstart, &textstart);
+        detect_horiz (BTOP, &scratch, &boxstart, &textstart);
         #ifdef DEBUG
             fprintf (stderr, "----> First line of box is %d, ", boxstart);
             fprintf (stderr, "first line of box body (text) is %d.\n", textstart);
@@ -855,7 +1335,7 @@ int remove_box()
     /*
      *  Phase 2: Find out how many lines belong to the bottom of the box
      */
-    if (empty_side (opt.design->shape, BBOT)) {
+    if (opt.design->metrics.empty[BBOT]) {
         textend = input.anz_lines; 
         boxend = input.anz_lines;
         #ifdef DEBUG
@@ -866,7 +1346,7 @@ int remove_box()
     else {
         textend = 0;
         boxend = 0;
-        detect_horiz (BBOT, &textend, &boxend);
+        detect_horiz (BBOT, &scratch, &textend, &boxend);
         if (textend == 0 && boxend == 0) {
             textend = input.anz_lines; 
             boxend = input.anz_lines;
@@ -876,6 +1356,7 @@ int remove_box()
             fprintf (stderr, "last line of box is %d.\n", boxend-1);
         #endif
     }
+    free_scratch (&scratch);
 
     /*
      *  Phase 3: Iterate over body lines, removing box sides where applicable
@@ -921,6 +1402,9 @@ int remove_box()
         }
     }
 
+    if (opt.design->anz_revrules > 0)
+        note_padding (input.maxline + opt.design->shape[NE].width);
+
     /*
      *  Remove as many spaces from the left side of the line as the west side
      *  of the box was wide. Don't do it if we never removed anything from the
@@ -954,13 +1438,13 @@ int remove_box()
      *  Phase 4: Remove box top and body lines from input
      */
     if (opt.killblank) {
-        while (empty_line (input.lines+textstart) && textstart < textend) {
+        while (textstart < textend && empty_line (input.lines+textstart)) {
             #ifdef DEBUG
                 fprintf (stderr, "Killing leading blank line in box body.\n");
             #endif
             ++textstart;
         }
-        while (empty_line (input.lines+textend-1) && textend > textstart) {
+        while (textend > textstart && empty_line (input.lines+textend-1)) {
             #ifdef DEBUG
                 fprintf (stderr, "Killing trailing blank line in box body.\n");
             #endif
@@ -969,8 +1453,10 @@ int remove_box()
     }
 
     if (textstart > boxstart) {
-        for (j=boxstart; j<textstart; ++j)
+        for (j=boxstart; j<textstart; ++j) {
             BFREE (input.lines[j].text);
+            BFREE (input.lines[j].tabpos);
+        }
         memmove (input.lines+boxstart, input.lines+textstart,
                 (input.anz_lines-textstart)*sizeof(line_t));
         input.anz_lines -= textstart - boxstart;
@@ -978,8 +1464,10 @@ int remove_box()
         boxend -= textstart - boxstart;
     }
     if (boxend > textend) {
-        for (j=textend; j<boxend; ++j)
+        for (j=textend; j<boxend; ++j) {
             BFREE (input.lines[j].text);
+            BFREE (input.lines[j].tabpos);
+        }
         if (boxend < input.anz_lines) {
             memmove (input.lines+textend, input.lines+boxend,
                     (input.anz_lines-boxend)*sizeof(line_t));
@@ -1011,9 +1499,133 @@ int remove_box()
 
 
 
+int remove_box()
+/*
+ *  Remove box from input.
+ *
+ *  RETURNS:  == 0  success
+ *            != 0  error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int rc;
+
+    rc = prepare_removal();
+    if (rc)
+        return rc;
+    return strip_box();
+}
+
+
+
+static int match_sides (const size_t lidx)
+/*
+ *  Check whether input line lidx looks like a line of a box body, i.e.
+ *  has a west or east side of the box. Designs whose west and east sides
+ *  are both empty match any line.
+ *
+ *  RETURNS:  != 0  line may be part of the box body
+ *            == 0  line cannot be part of the box body
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *ws, *we, *es, *ee;
+
+    if (opt.design->anz_west_trims == 0 && opt.design->anz_east_trims == 0)
+        return 1;
+    return best_match (input.lines + lidx, &ws, &we, &es, &ee) > 0;
+}
+
+
+
+int find_box (const size_t from, size_t *boxstart, size_t *boxend)
+/*
+ *  Find the next box in input, starting the search at line index from.
+ *  This is for removing all boxes from a document (-g), so the box may be
+ *  surrounded by any number of lines which are not part of a box.
+ *
+ *      from      index of first input line to consider
+ *      boxstart  index of first line of box (result)
+ *      boxend    index of first line trailing the box (result)
+ *
+ *  A box begins with a complete top side, and ends with a complete bottom
+ *  side. Every line in between must match a west or east side. If the
+ *  top or bottom side is empty, the box begins or ends with the lines
+ *  matching a side. A box which isn't complete is not a box, but the
+ *  search continues where it was broken off, so every line is examined
+ *  only once or twice, no matter how many boxes there are.
+ *
+ *  prepare_removal() must have been called before.
+ *
+ *  RETURNS:  == 0   success (boxstart & boxend are set)
+ *            != 0   no more boxes
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int       notop = opt.design->metrics.empty[BTOP];
+    int       nobot = opt.design->metrics.empty[BBOT];
+    size_t    start = 0;                 /* first line of current box */
+    int       inbox = 0;                 /* true if inside of a box */
+    scratch_t scratch;                   /* work space of detect_horiz() */
+    int       rc = 1;
+    size_t    j;
+
+    if (alloc_scratch (&scratch))
+        return 1;
+
+    for (j=from; j<input.anz_lines; ) {
+        if (!inbox) {
+            if (notop? match_sides (j): match_horiz (BTOP, j, &scratch)) {
+                start = j;
+                inbox = 1;
+                if (!notop)
+                    j += opt.design->shape[sides[BTOP][0]].height;
+            }
+            else {
+                ++j;
+            }
+            continue;
+        }
+
+        if (!nobot && match_horiz (BBOT, j, &scratch)) {
+            *boxstart = start;
+            *boxend = j + opt.design->shape[sides[BBOT][0]].height;
+            rc = 0;
+            break;
+        }
+        if ((!notop && match_horiz (BTOP, j, &scratch)) || !match_sides (j)) {
+            /* the box ends here without a bottom, next one may start */
+            inbox = 0;
+            if (nobot && j > start) {
+                *boxstart = start;
+                *boxend = j;
+                rc = 0;
+                break;
+            }
+            #ifdef DEBUG
+                fprintf (stderr, "Incomplete box in lines %d to %d.\n",
+                        start, j-1);
+            #endif
+            continue;
+        }
+        ++j;
+    }
+
+    if (rc && inbox && nobot) {
+        *boxstart = start;
+        *boxend = input.anz_lines;
+        rc = 0;
+    }
+    free_scratch (&scratch);
+    return rc;
+}
+
 void output_input (const int trim_only)
 /*
- *  Output contents of input line list "as is" to standard output, except
+ *  Output contents of input line list "as is" to the output file, except
  *  for removal of trailing spaces (trimming).
  *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
@@ -1050,7 +1662,7 @@ void output_input (const int trim_only)
             indentspc[ntabs+nspcs] = '\0';
         }
         else if (opt.tabexp == 'k') {
-            indentspc = tabbify_indent (j, NULL, input.indent);
+            indentspc = tabbify_indent (input.lines + j, NULL, input.indent);
             indent = input.indent;
         }
         else {
@@ -1058,7 +1670,7 @@ void output_input (const int trim_only)
             indent = 0;
         }
         
-        printf ("%s%s\n", indentspc, input.lines[j].text + indent);
+        fprintf (opt.outfile, "%s%s\n", indentspc, input.lines[j].text + indent);
         BFREE (indentspc);
     }
 }
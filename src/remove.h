@@ -27,7 +27,12 @@
 #define REMOVE_H
 
 
+int build_trims (design_t *d);
+design_t *detect_design (long *margin);
+int prepare_removal();
+int strip_box();
 int remove_box();
+int find_box (const size_t from, size_t *boxstart, size_t *boxend);
 void output_input();
 
 
@@ -0,0 +1,1382 @@
+/*
+ *  File:             server.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 15:29h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Server mode, and the client which sends requests to it
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *  In server mode (-w), boxes keeps the designs of its config file in
+ *  memory and processes requests sent to a Unix domain socket. If the
+ *  BOXES_SERVER environment variable names that socket, boxes acts as a
+ *  client: instead of reading the config file, it sends its options and
+ *  input to the server and writes the server's result. If the server is
+ *  not available, or cannot handle the request, the client processes the
+ *  input itself, so the result is always the same as without a server.
+ *
+ *  Protocol: Every message consists of frames. A frame is a length of four
+ *  bytes (most significant first), followed by that many bytes of data.
+ *
+ *      request:   config   name of the config file used by the client
+ *                 options  one string per option, each terminated by
+ *                          '\0': option character, then argument
+ *                 text     input text
+ *
+ *      response:  status   one byte, 0 on success
+ *                 text     output text
+ *
+ *  A client may send any number of requests over one connection. Between
+ *  requests, the connection does not occupy a server thread.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNIX_SOCKETS
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "lexer.h"
+#include "process.h"
+#include "batch.h"
+#include "server.h"
+
+
+
+#define MAX_FRAME     (256L*1024*1024)   /* largest frame accepted */
+#define IDLE_TIMEOUT  10                 /* seconds before idle client is dropped */
+#define SETTLE_TIME   200                /* ms without change before reload */
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL  0
+#endif
+
+extern int yyparse();
+
+
+static char   *fwd_options = NULL;       /* options to send, see client_option() */
+static size_t  fwd_len = 0;              /* bytes used in fwd_options */
+static size_t  fwd_alloc = 0;            /* bytes allocated for fwd_options */
+
+#ifdef HAVE_UNIX_SOCKETS
+static const char *sock_path = NULL;     /* server socket, removed on exit */
+static int         listen_fd = -1;       /* server socket */
+static char       *server_config = NULL; /* config file of the server */
+
+/*
+ *  The designs read from the config file. The server threads work on
+ *  private copies of them (see copy_designs()), which share their shapes
+ *  and strings, so a set of designs replaced by a newer one is only freed
+ *  when the last thread using it has switched to the new one.
+ */
+typedef struct {
+    design_t *designs;                   /* designs read from config file */
+    int       anz_designs;               /* number of entries in designs */
+    int       refs;                      /* threads using it, +1 if current */
+} designset_t;
+
+static designset_t *current_set = NULL;  /* most recently read designs */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t set_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+#endif
+
+
+
+int client_option (const int oc, const char *arg)
+/*
+ *  Remember an option given on the command line, so that it can be sent to
+ *  the server. Must be called for every option, in order.
+ *
+ *    oc    option character
+ *    arg   option argument, or NULL
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t len = 2 + (arg? strlen (arg): 0);
+    char  *tmp;
+
+    if (fwd_len + len > fwd_alloc) {
+        size_t n = fwd_alloc? 2 * fwd_alloc: 256;
+        while (n < fwd_len + len)
+            n *= 2;
+        tmp = (char *) realloc (fwd_options, n);
+        if (tmp == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        fwd_options = tmp;
+        fwd_alloc = n;
+    }
+    fwd_options[fwd_len] = (char) oc;
+    strcpy (fwd_options + fwd_len + 1, arg? arg: "");
+    fwd_len += len;
+    return 0;
+}
+
+
+
+#ifdef HAVE_UNIX_SOCKETS
+
+static int read_full (int fd, char *buf, size_t len)
+/*
+ *  Read exactly len bytes from fd into buf.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error or end of file
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = read (fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+
+
+static int write_full (int fd, const char *buf, size_t len)
+/*
+ *  Write exactly len bytes from buf to fd. A closed connection results in
+ *  an error, not in SIGPIPE.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = send (fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+
+
+static int read_frame (int fd, char **buf, size_t *len)
+/*
+ *  Read a frame from fd. The data is terminated by an extra '\0', which
+ *  is not counted in len.
+ *
+ *    buf   RESULT: the data, allocated, to be freed by the caller
+ *    len   RESULT: length of the data
+ *
+ *  RETURNS:  == 0   success
+ *             > 0   error (also end of file within the frame)
+ *             < 0   end of file before the frame
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    unsigned char hdr[4];
+    unsigned long n;
+    ssize_t       rc;
+
+    do {
+        rc = read (fd, hdr, 1);
+    } while (rc < 0 && errno == EINTR);
+    if (rc == 0)
+        return -1;
+    if (rc < 0 || read_full (fd, (char *) hdr + 1, 3))
+        return 1;
+
+    n = ((unsigned long) hdr[0] << 24) | ((unsigned long) hdr[1] << 16)
+      | ((unsigned long) hdr[2] << 8) | (unsigned long) hdr[3];
+    if (n > (unsigned long) MAX_FRAME)
+        return 1;
+
+    *buf = (char *) malloc (n + 1);
+    if (*buf == NULL)
+        return 1;
+    if (read_full (fd, *buf, n)) {
+        BFREE (*buf);
+        return 1;
+    }
+    (*buf)[n] = '\0';
+    *len = n;
+    return 0;
+}
+
+
+
+static int write_frame (int fd, const char *buf, const size_t len)
+/*
+ *  Write a frame of len bytes from buf to fd.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char hdr[4];
+
+    if (len > (size_t) MAX_FRAME)
+        return 1;
+    hdr[0] = (char) ((len >> 24) & 0xff);
+    hdr[1] = (char) ((len >> 16) & 0xff);
+    hdr[2] = (char) ((len >> 8) & 0xff);
+    hdr[3] = (char) (len & 0xff);
+    if (write_full (fd, hdr, 4))
+        return 1;
+    return write_full (fd, buf, len);
+}
+
+
+
+static char *config_identity (const char *name)
+/*
+ *  Return the absolute path of the config file name, so that client and
+ *  server can check that they use the same designs. Names which are no
+ *  files (built-in designs) are returned as they are.
+ *
+ *  RETURNS:  != NULL   the identity, allocated
+ *            == NULL   out of memory
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char buf[PATH_MAX];
+
+    if (name == NULL)
+        name = "";
+    if (realpath (name, buf) != NULL)
+        return (char *) strdup (buf);
+    return (char *) strdup (name);
+}
+
+
+
+static int connect_socket (const char *path)
+/*
+ *  Connect to the server listening on the socket path.
+ *
+ *  RETURNS:  >= 0   the connected socket
+ *             < 0   error, errno is set
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    struct sockaddr_un addr;
+    int                fd;
+    int                err;
+
+    if (strlen (path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset (&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect (fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        err = errno;
+        close (fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+
+
+static char *read_input (FILE *f, size_t *len)
+/*
+ *  Read all of f into memory.
+ *
+ *  RETURNS:  != NULL   the data, allocated, *len is its length
+ *            == NULL   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t  alloc = 64 * 1024;
+    size_t  n;
+    char   *buf;
+    char   *tmp;
+
+    *len = 0;
+    buf = (char *) malloc (alloc);
+    if (buf == NULL) {
+        perror (PROJECT);
+        return NULL;
+    }
+    while ((n = fread (buf + *len, 1, alloc - *len, f)) > 0) {
+        *len += n;
+        if (*len == alloc) {
+            tmp = (char *) realloc (buf, 2 * alloc);
+            if (tmp == NULL) {
+                perror (PROJECT);
+                BFREE (buf);
+                return NULL;
+            }
+            buf = tmp;
+            alloc *= 2;
+        }
+    }
+    if (ferror (f)) {
+        perror (PROJECT);
+        BFREE (buf);
+        return NULL;
+    }
+    return buf;
+}
+
+
+
+int client_run (const char *path, const char *config)
+/*
+ *  Have the server listening on the socket path process opt.infile, and
+ *  write the result to opt.outfile. The options recorded by client_option()
+ *  are sent along with the input.
+ *
+ *  If the server cannot be reached, nothing is done. If it fails to process
+ *  the input, opt.infile is replaced by the input already read, so that
+ *  the caller can process it.
+ *
+ *    config   name of the config file which the caller would use
+ *
+ *  RETURNS:  == 0   success
+ *             > 0   error
+ *             < 0   caller must process the input itself
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int     fd;
+    char   *ident;
+    char   *text;
+    size_t  len;
+    char   *status = NULL;
+    char   *out = NULL;
+    size_t  n;
+    size_t  outlen;
+    int     ok;
+
+    fd = connect_socket (path);
+    if (fd < 0) {
+        #ifdef DEBUG
+            fprintf (stderr, "No server at %s (%s).\n", path, strerror (errno));
+        #endif
+        return -1;
+    }
+    text = read_input (opt.infile, &len);
+    ident = config_identity (config);
+    if (text == NULL || ident == NULL) {
+        close (fd);
+        BFREE (text);
+        BFREE (ident);
+        return 1;
+    }
+
+    ok = write_frame (fd, ident, strlen (ident)) == 0
+      && write_frame (fd, fwd_options, fwd_len) == 0
+      && write_frame (fd, text, len) == 0
+      && read_frame (fd, &status, &n) == 0;
+    ok = ok && n == 1 && status[0] == 0 && read_frame (fd, &out, &outlen) == 0;
+    close (fd);
+    BFREE (ident);
+    BFREE (status);
+
+    if (!ok) {
+        #ifdef DEBUG
+            fprintf (stderr, "Server did not process the request.\n");
+        #endif
+        if (len > 0) {                   /* else input is at EOF anyway */
+            opt.infile = fmemopen (text, len, "r");   /* text stays in use */
+            if (opt.infile == NULL) {
+                perror (PROJECT);
+                return 1;
+            }
+        }
+        else {
+            BFREE (text);
+        }
+        return -1;
+    }
+
+    BFREE (text);
+    if (fwrite (out, 1, outlen, opt.outfile) != outlen || fflush (opt.outfile)) {
+        perror (PROJECT);
+        BFREE (out);
+        return 1;
+    }
+    BFREE (out);
+    return 0;
+}
+
+
+
+static design_t *find_design (const char *name)
+{
+    int i;
+
+    for (i=0; i<anz_designs; ++i) {
+        if (!strcasecmp (name, designs[i].name))
+            return designs + i;
+    }
+    return NULL;
+}
+
+
+
+static int request_options (char *opts, const size_t len)
+/*
+ *  Set the options of a request, like process_commandline() does for the
+ *  options of the command line. Only the options which control how the
+ *  box is drawn or removed are supported.
+ *
+ *    opts   options as sent by client_run(), modified
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   invalid or unsupported option
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *p;
+    char *arg;
+
+    set_default_options();
+    opt.design = designs;
+
+    for (p=opts; p<opts+len; p=arg+strlen(arg)+1) {
+        arg = p + 1;
+        if (arg > opts + len)
+            return 1;
+        switch (*p) {
+            case 'a': case 'b': case 'i': case 'k':
+            case 'p': case 'q': case 's': case 't': case 'z':
+                if (set_option (*p, arg))
+                    return 1;
+                break;
+
+            case 'd':                    /* design lists are left to client */
+                opt.design = strchr (arg, ',')? NULL: find_design (arg);
+                if (opt.design == NULL)
+                    return 1;
+                opt.design_choice_by_user = 1;
+                break;
+
+            case 'e': case 'f':          /* config is checked separately */
+                break;
+
+            case 'g':
+                opt.global = 1;
+                opt.r = 1;
+                break;
+
+            case 'm':
+                opt.mend = 1;
+                opt.r = 1;
+                opt.killblank = 0;
+                break;
+
+            case 'r':
+                opt.r = 1;
+                break;
+
+            case 'x':
+                opt.target = find_design (arg);
+                if (opt.target == NULL)
+                    return 1;
+                opt.mend = 1;
+                opt.r = 1;
+                opt.killblank = 0;
+                break;
+
+            default:
+                return 1;
+        }
+    }
+
+    if (opt.global && (opt.mend || opt.recmode || !opt.design_choice_by_user))
+        return 1;
+    return 0;
+}
+
+
+
+static void put_set (designset_t *set)
+/*
+ *  Stop using set. It is freed if it is no longer used at all.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int refs;
+
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_lock (&set_lock);
+    #endif
+    refs = --(set->refs);
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_unlock (&set_lock);
+    #endif
+
+    if (refs == 0) {
+        free_designs (set->designs, set->anz_designs);
+        BFREE (set);
+    }
+}
+
+
+
+static int switch_designs (designset_t **set)
+/*
+ *  Make the current designs the designs of the calling thread, unless they
+ *  are already.
+ *
+ *    set   the set of designs used by the calling thread, or NULL if none
+ *          yet; RESULT: the set now in use
+ *
+ *  RETURNS:  == 0   success (also if the old designs must be kept)
+ *            != 0   error, the thread has no designs
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    designset_t *cur;
+    design_t    *copy;
+
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_lock (&set_lock);
+    #endif
+    cur = current_set;
+    if (cur != *set)
+        ++(cur->refs);
+    #ifdef HAVE_PTHREAD
+        pthread_mutex_unlock (&set_lock);
+    #endif
+    if (cur == *set)
+        return 0;
+
+    copy = copy_designs (cur->designs, cur->anz_designs);
+    if (copy == NULL) {
+        put_set (cur);
+        return *set == NULL;
+    }
+    if (*set) {
+        free_design_copy (designs, anz_designs);
+        put_set (*set);
+    }
+    designs = copy;
+    anz_designs = cur->anz_designs;
+    design_idx = anz_designs - 1;
+    *set = cur;
+    return 0;
+}
+
+
+
+static int handle_request (const designset_t *set, const char *config,
+                           char *opts, const size_t optlen,
+                           char *text, const size_t len, char **out, size_t *outlen)
+/*
+ *  Process a request using the designs of the current thread, which are a
+ *  copy of set.
+ *
+ *    out      RESULT: output text, allocated
+ *    outlen   RESULT: length of output text
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error, or request not supported
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int i;
+    int rc;
+
+    *out = NULL;
+    *outlen = 0;
+    if (strcmp (config, server_config) != 0)
+        return 1;                        /* client uses other designs */
+
+    rc = request_options (opts, optlen);
+    if (rc == 0 && len > 0) {
+        opt.infile = fmemopen (text, len, "r");
+        opt.outfile = opt.infile? open_memstream (out, outlen): NULL;
+        if (opt.outfile == NULL) {
+            perror (PROJECT);
+            if (opt.infile)
+                fclose (opt.infile);
+            rc = 1;
+        }
+        else {
+            apply_design_options();
+            rc = process_input();
+            fclose (opt.infile);
+            if (fclose (opt.outfile) && rc == 0)
+                rc = 1;
+        }
+    }
+    BFREE (opt.recsep);
+
+    /*
+     *  Undo apply_design_options(), as the next request may have other
+     *  options.
+     */
+    for (i=0; i<anz_designs; ++i) {
+        designs[i].minwidth = set->designs[i].minwidth;
+        designs[i].minheight = set->designs[i].minheight;
+        designs[i].indentmode = set->designs[i].indentmode;
+    }
+    return rc;
+}
+
+
+
+/*
+ *  Connections of clients which are waiting for a request, watched by
+ *  dispatch(). A connection with a request to read is taken out of the
+ *  list and given to a server thread, which hands it back when it has
+ *  answered the request, so that no thread waits on an idle client.
+ */
+typedef struct {
+    int    fd;                           /* connection */
+    time_t since;                        /* time of last request */
+} conn_t;
+
+#ifdef HAVE_PTHREAD
+typedef struct {
+    int *fds;                            /* connections, in order of arrival */
+    int  anz;                            /* number of entries in fds */
+    int  alloc;                          /* entries allocated for fds */
+} fdqueue_t;
+
+static fdqueue_t       ready = {NULL, 0, 0};     /* requests to serve */
+static fdqueue_t       handed_back = {NULL, 0, 0}; /* served, to watch again */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_cond = PTHREAD_COND_INITIALIZER;
+static int             wake_pipe[2] = {-1, -1};  /* wakes up dispatch() */
+
+
+
+static int push_fd (fdqueue_t *q, const int fd)
+/*
+ *  Append fd to the queue q.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int *tmp;
+
+    if (q->anz == q->alloc) {
+        tmp = (int *) realloc (q->fds, (q->alloc? 2 * q->alloc: 16) * sizeof(int));
+        if (tmp == NULL) {
+            perror (PROJECT);
+            return 1;
+        }
+        q->fds = tmp;
+        q->alloc = q->alloc? 2 * q->alloc: 16;
+    }
+    q->fds[q->anz++] = fd;
+    return 0;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+
+static int serve_request (int fd, designset_t **set)
+/*
+ *  Process one request of a client, using the designs most recently read
+ *  from the config file.
+ *
+ *    set   the set of designs used by the calling thread (see
+ *          switch_designs())
+ *
+ *  RETURNS:  == 0   success, the connection may be used for more requests
+ *            != 0   the client closed the connection, or error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char   *config = NULL, *opts = NULL, *text = NULL, *out = NULL;
+    size_t  n, optlen, len, outlen;
+    char    status;
+    int     rc;
+
+    if (read_frame (fd, &config, &n)
+            || read_frame (fd, &opts, &optlen) > 0
+            || read_frame (fd, &text, &len))
+    {
+        BFREE (config);
+        BFREE (opts);
+        return 1;
+    }
+
+    status = switch_designs (set)
+        || handle_request (*set, config, opts, optlen, text, len, &out, &outlen);
+    if (status)
+        outlen = 0;
+    rc = write_frame (fd, &status, 1) || write_frame (fd, out, outlen);
+
+    BFREE (config);
+    BFREE (opts);
+    BFREE (text);
+    BFREE (out);
+    return rc;
+}
+
+
+
+#ifdef HAVE_PTHREAD
+
+static void *server_worker (void *arg)
+/*
+ *  Main function of a server thread. Serves the requests queued by
+ *  dispatch() one after another, using a private copy of the designs, and
+ *  hands each connection back when its request has been answered.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    designset_t *set = NULL;
+    int          fd;
+    int          rc;
+
+    (void) arg;
+    for (;;) {
+        pthread_mutex_lock (&queue_lock);
+        while (ready.anz == 0)
+            pthread_cond_wait (&queue_cond, &queue_lock);
+        fd = ready.fds[0];
+        memmove (ready.fds, ready.fds + 1, --(ready.anz) * sizeof(int));
+        pthread_mutex_unlock (&queue_lock);
+
+        if (serve_request (fd, &set)) {
+            close (fd);
+            continue;
+        }
+        pthread_mutex_lock (&queue_lock);
+        rc = push_fd (&handed_back, fd);
+        pthread_mutex_unlock (&queue_lock);
+        if (rc)
+            close (fd);
+        else if (write (wake_pipe[1], "", 1) < 0 && errno != EAGAIN)
+            perror (PROJECT);
+    }
+    return NULL;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+
+static int add_conn (conn_t **conns, int *anz, int *alloc, const int fd,
+                     const time_t now)
+/*
+ *  Add the connection fd to the connections watched by dispatch(). It is
+ *  closed if that fails.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    conn_t *tmp;
+
+    if (*anz == *alloc) {
+        tmp = (conn_t *) realloc (*conns, (*alloc? 2 * *alloc: 16) * sizeof(conn_t));
+        if (tmp == NULL) {
+            perror (PROJECT);
+            close (fd);
+            return 1;
+        }
+        *conns = tmp;
+        *alloc = *alloc? 2 * *alloc: 16;
+    }
+    (*conns)[*anz].fd = fd;
+    (*conns)[*anz].since = now;
+    ++(*anz);
+    return 0;
+}
+
+
+
+static int dispatch()
+/*
+ *  Accept connections on the server socket and watch them for requests.
+ *  A request is queued for the server threads, or served right away if
+ *  there are none. Connections which stay idle for IDLE_TIMEOUT seconds
+ *  are closed.
+ *
+ *  RETURNS:  != 0   error (only returns on error)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    conn_t         *conns = NULL;        /* idle connections */
+    int             anz = 0;             /* number of entries in conns */
+    int             alloc = 0;           /* entries allocated for conns */
+    struct pollfd  *pfd = NULL;          /* fds to poll: socket, pipe, conns */
+    int             pfd_alloc = 0;       /* entries allocated for pfd */
+    int             base;                /* index of first connection in pfd */
+    struct timeval  tv;
+    time_t          now;
+    int             fd;
+    int             i, j;
+    #ifdef HAVE_PTHREAD
+        char        buf[64];
+    #else
+        designset_t *set = NULL;
+    #endif
+
+    for (;;) {
+        now = time (NULL);
+        #ifdef HAVE_PTHREAD
+            pthread_mutex_lock (&queue_lock);
+            for (i=0; i<handed_back.anz; ++i)
+                add_conn (&conns, &anz, &alloc, handed_back.fds[i], now);
+            handed_back.anz = 0;
+            pthread_mutex_unlock (&queue_lock);
+        #endif
+
+        if (anz + 2 > pfd_alloc) {
+            struct pollfd *tmp = (struct pollfd *) realloc (pfd,
+                    (anz + 2) * 2 * sizeof(struct pollfd));
+            if (tmp == NULL) {
+                perror (PROJECT);
+                break;
+            }
+            pfd = tmp;
+            pfd_alloc = (anz + 2) * 2;
+        }
+        base = 0;
+        pfd[base].fd = listen_fd;
+        pfd[base++].events = POLLIN;
+        #ifdef HAVE_PTHREAD
+            pfd[base].fd = wake_pipe[0];
+            pfd[base++].events = POLLIN;
+        #endif
+        for (i=0; i<anz; ++i) {
+            pfd[base+i].fd = conns[i].fd;
+            pfd[base+i].events = POLLIN;
+            pfd[base+i].revents = 0;
+        }
+
+        if (poll (pfd, base + anz, 1000) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror (PROJECT);
+            break;
+        }
+        now = time (NULL);
+
+        #ifdef HAVE_PTHREAD
+            if (pfd[1].revents) {
+                while (read (wake_pipe[0], buf, sizeof(buf)) > 0);
+            }
+        #endif
+
+        /*
+         *  Hand on the connections with a request, close those idle for too
+         *  long, and keep the others.
+         */
+        for (i=0, j=0; i<anz; ++i) {
+            fd = conns[i].fd;
+            if (pfd[base+i].revents) {
+                #ifdef HAVE_PTHREAD
+                    pthread_mutex_lock (&queue_lock);
+                    if (push_fd (&ready, fd))
+                        close (fd);
+                    else
+                        pthread_cond_signal (&queue_cond);
+                    pthread_mutex_unlock (&queue_lock);
+                    continue;
+                #else
+                    if (serve_request (fd, &set)) {
+                        close (fd);
+                        continue;
+                    }
+                    conns[i].since = time (NULL);
+                #endif
+            }
+            else if (now - conns[i].since >= IDLE_TIMEOUT) {
+                close (fd);
+                continue;
+            }
+            conns[j++] = conns[i];
+        }
+        anz = j;
+
+        if (pfd[0].revents) {
+            fd = accept (listen_fd, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+                    continue;
+                perror (PROJECT);
+                break;
+            }
+            tv.tv_sec = IDLE_TIMEOUT;    /* for a client stalling mid-request */
+            tv.tv_usec = 0;
+            setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            add_conn (&conns, &anz, &alloc, fd, now);
+        }
+    }
+
+    for (i=0; i<anz; ++i)
+        close (conns[i].fd);
+    BFREE (conns);
+    BFREE (pfd);
+    return 1;
+}
+
+
+
+#ifdef HAVE_INOTIFY
+
+typedef struct {
+    int         wd;                      /* inotify watch descriptor */
+    const char *name;                    /* file name within watched directory */
+} watch_t;
+
+
+
+static int add_watch (int fd, char *path, watch_t *w)
+/*
+ *  Watch the directory containing the file path for changes to that file.
+ *  The directory is watched instead of the file itself, because editors
+ *  often replace the file rather than write to it.
+ *
+ *    path   file to watch, modified, must be kept as long as w is used
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *p = strrchr (path, '/');
+
+    if (p == NULL) {
+        w->name = path;
+        w->wd = inotify_add_watch (fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    }
+    else {
+        *p = '\0';
+        w->name = p + 1;
+        w->wd = inotify_add_watch (fd, p == path? "/": path,
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    }
+    return w->wd < 0;
+}
+
+
+
+static int wait_change (int fd, const watch_t *w, const int anz)
+/*
+ *  Wait until one of the anz watched files has changed, and for the changes
+ *  to settle, as a file is often written in several steps.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    union {
+        struct inotify_event ev;
+        char                 buf[4096];
+    } u;
+    const struct inotify_event *ev;
+    struct pollfd pfd;
+    ssize_t       n;
+    char         *p;
+    int           changed = 0;
+    int           i;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for (;;) {
+        if (changed && poll (&pfd, 1, SETTLE_TIME) == 0)
+            return 0;
+        n = read (fd, u.buf, sizeof(u.buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+        for (p=u.buf; p<u.buf+n; p+=sizeof(struct inotify_event)+ev->len) {
+            ev = (const struct inotify_event *) p;
+            for (i=0; ev->len && i<anz; ++i) {
+                if (ev->wd == w[i].wd && strcmp (ev->name, w[i].name) == 0)
+                    changed = 1;
+            }
+        }
+    }
+}
+
+
+
+static designset_t *read_config (const char *path)
+/*
+ *  Read all designs from the config file path.
+ *
+ *  The config parser is not reentrant. This is safe because the main
+ *  thread has finished parsing before the server is started, and the
+ *  server threads do not use the parser.
+ *
+ *  RETURNS:  != NULL   the new set of designs, used by nobody yet
+ *            == NULL   error (file not readable or invalid)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    designset_t *set;
+    FILE        *f;
+    int          rc;
+
+    f = fopen (path, "r");
+    if (f == NULL) {
+        fprintf (stderr, "%s: Couldn\'t open config file \'%s\' for input.\n",
+                PROJECT, path);
+        return NULL;
+    }
+    set_default_options();
+    opt.server = (char *) sock_path;     /* read all designs, see parser.y */
+    designs = NULL;
+    anz_designs = 0;
+    lexer_restart (f);
+    rc = yyparse();
+    fclose (f);
+    if (rc)
+        return NULL;
+
+    set = (designset_t *) malloc (sizeof(designset_t));
+    if (set == NULL) {
+        perror (PROJECT);
+        free_designs (designs, anz_designs);
+        return NULL;
+    }
+    set->designs = designs;
+    set->anz_designs = anz_designs;
+    set->refs = 0;
+    designs = NULL;
+    return set;
+}
+
+
+
+static void *reload_worker (void *arg)
+/*
+ *  Main function of the thread which reads the config file again whenever
+ *  it changes, and makes the new designs the current ones. Requests being
+ *  processed meanwhile are not held up. If the config file is invalid, the
+ *  previous designs stay in use.
+ *
+ *    arg   name of the config file
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const char  *path = (const char *) arg;
+    char        *names[2];
+    watch_t      w[2];
+    int          anz = 0;
+    int          fd;
+    designset_t *set;
+    designset_t *old;
+
+    fd = inotify_init();
+    if (fd < 0) {
+        perror (PROJECT);
+        return NULL;
+    }
+
+    /*
+     *  If the config file is a symbolic link, the file it points to is
+     *  watched as well.
+     */
+    names[0] = (char *) strdup (path);
+    names[1] = (char *) strdup (server_config);
+    if (names[0] && !add_watch (fd, names[0], w + anz))
+        ++anz;
+    if (names[1] && strcmp (path, server_config) != 0
+            && !add_watch (fd, names[1], w + anz))
+        ++anz;
+    if (anz == 0) {
+        fprintf (stderr, "%s: Can\'t watch config file %s -- %s\n", PROJECT,
+                path, strerror (errno));
+    }
+
+    while (anz > 0 && wait_change (fd, w, anz) == 0) {
+        set = read_config (path);
+        if (set == NULL)
+            continue;
+        set->refs = 1;
+        pthread_mutex_lock (&set_lock);
+        old = current_set;
+        current_set = set;
+        pthread_mutex_unlock (&set_lock);
+        put_set (old);
+        #ifdef DEBUG
+            fprintf (stderr, "Config file %s read again, %d designs.\n",
+                    path, set->anz_designs);
+        #endif
+    }
+
+    close (fd);
+    BFREE (names[0]);
+    BFREE (names[1]);
+    return NULL;
+}
+
+#endif /* HAVE_INOTIFY */
+
+
+
+static void remove_socket (int sig)
+/*
+ *  Signal handler which removes the server socket, then terminates.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (sock_path)
+        unlink (sock_path);
+    signal (sig, SIG_DFL);
+    raise (sig);
+}
+
+
+
+static int open_socket (const char *path)
+/*
+ *  Create the server socket path and listen on it. Only the owner may
+ *  connect. A socket left over from a server which is gone is replaced.
+ *
+ *  RETURNS:  == 0   success, listen_fd is set
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    struct sockaddr_un addr;
+    struct stat        st;
+    mode_t             mask;
+    int                fd;
+    int                rc;
+
+    if (strlen (path) >= sizeof(addr.sun_path)) {
+        fprintf (stderr, "%s: socket path too long -- %s\n", PROJECT, path);
+        return 1;
+    }
+    if (lstat (path, &st) == 0) {
+        fd = connect_socket (path);
+        if (fd >= 0 || !S_ISSOCK (st.st_mode) || errno != ECONNREFUSED) {
+            if (fd >= 0)
+                close (fd);
+            fprintf (stderr, "%s: socket path already in use -- %s\n",
+                    PROJECT, path);
+            return 1;
+        }
+        unlink (path);
+    }
+
+    memset (&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror (PROJECT);
+        return 1;
+    }
+    mask = umask (077);
+    rc = bind (fd, (struct sockaddr *) &addr, sizeof(addr));
+    umask (mask);
+    if (rc || listen (fd, SOMAXCONN)) {
+        fprintf (stderr, "%s: Can\'t listen on socket %s -- %s\n", PROJECT,
+                path, strerror (errno));
+        close (fd);
+        return 1;
+    }
+
+    listen_fd = fd;
+    return 0;
+}
+
+
+
+int server_run (const char *path, const int reload)
+/*
+ *  Serve requests on the socket path until terminated by a signal, using
+ *  opt.jobs threads (one per CPU if not given) besides the calling thread,
+ *  which watches the connections. The designs must have been read from the
+ *  config file, which is yyfilename.
+ *
+ *    reload   read the config file again when it changes
+ *
+ *  RETURNS:  != 0   error (only returns on error)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int anz = opt.jobs;
+    int rc;
+    #ifdef HAVE_PTHREAD
+        pthread_t  thread;
+        int        i;
+    #endif
+    #ifdef HAVE_INOTIFY
+        pthread_t  watcher;
+    #endif
+
+    current_set = (designset_t *) malloc (sizeof(designset_t));
+    if (current_set == NULL) {
+        perror (PROJECT);
+        return 1;
+    }
+    current_set->designs = designs;
+    current_set->anz_designs = anz_designs;
+    current_set->refs = 1;
+    server_config = config_identity (yyfilename);
+    if (server_config == NULL) {
+        perror (PROJECT);
+        return 1;
+    }
+    if (open_socket (path))
+        return 1;
+
+    sock_path = path;
+    signal (SIGPIPE, SIG_IGN);
+    signal (SIGINT, remove_socket);
+    signal (SIGTERM, remove_socket);
+    signal (SIGHUP, remove_socket);
+
+    #if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+        if (anz < 1)
+            anz = (int) sysconf (_SC_NPROCESSORS_ONLN);
+    #endif
+    if (anz < 1)
+        anz = 1;
+
+    #ifdef DEBUG
+        fprintf (stderr, "Server listening on %s with %d threads.\n", path, anz);
+    #endif
+
+    #ifdef HAVE_INOTIFY
+        if (reload && pthread_create (&watcher, NULL, reload_worker, yyfilename))
+            perror (PROJECT);
+    #else
+        (void) reload;
+    #endif
+
+    #ifdef HAVE_PTHREAD
+        if (pipe (wake_pipe)
+                || fcntl (wake_pipe[0], F_SETFL, O_NONBLOCK)
+                || fcntl (wake_pipe[1], F_SETFL, O_NONBLOCK))
+        {
+            perror (PROJECT);
+            anz = 0;
+        }
+        for (i=0; i<anz; ++i) {
+            if (pthread_create (&thread, NULL, server_worker, NULL)) {
+                perror (PROJECT);
+                break;
+            }
+            pthread_detach (thread);
+        }
+        rc = i > 0? dispatch(): 1;
+    #else
+        rc = dispatch();
+    #endif
+
+    unlink (path);
+    close (listen_fd);
+    return rc;
+}
+
+
+
+#else /* !HAVE_UNIX_SOCKETS */
+
+int client_run (const char *path, const char *config)
+{
+    (void) path;
+    (void) config;
+    return -1;
+}
+
+int server_run (const char *path, const int reload)
+{
+    (void) path;
+    (void) reload;
+    fprintf (stderr, "%s: server mode (-w) is not supported on this platform\n",
+            PROJECT);
+    return 1;
+}
+
+#endif /* HAVE_UNIX_SOCKETS */
+
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
@@ -308,38 +308,12 @@ shape_t leftmost (const int aside, const int cnt)
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    int c = 0;
-    int s;
-
-    if (cnt < 0)
+    if (aside < 0 || aside >= ANZ_SIDES)
+        return ANZ_SHAPES;
+    if (cnt < 0 || cnt >= opt.design->metrics.anz_middle[aside])
         return ANZ_SHAPES;
 
-    if (aside == BTOP) {
-        s = 0;
-        do {
-            ++s;
-            while (s < SHAPES_PER_SIDE-1 &&
-                    isempty(opt.design->shape + north_side[s]))
-                ++s;
-            if (s == SHAPES_PER_SIDE-1)
-                return ANZ_SHAPES;
-        } while (c++ < cnt);
-        return north_side[s];
-    }
-
-    else if (aside == BBOT) {
-        s = SHAPES_PER_SIDE - 1;
-        do {
-            --s;
-            while (s && isempty(opt.design->shape + south_side[s]))
-                --s;
-            if (!s)
-                return ANZ_SHAPES;
-        } while (c++ < cnt);
-        return south_side[s];
-    }
-
-    return ANZ_SHAPES;
+    return opt.design->metrics.middle[aside][cnt];
 }
 
 
@@ -372,4 +346,44 @@ int empty_side (sentry_t *sarr, const int aside)
 
 
 
+void measure_shapes (sentry_t *sarr, metrics_t *m)
+/*
+ *  Compute the metrics of a design from its shapes, so that they need not
+ *  be computed again whenever a box is drawn or removed.
+ *
+ *      sarr    pointer to shape list of design to measure
+ *      m       RESULT: the metrics
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    int     side;
+    int     i;
+    shape_t *sh;
+
+    memset (m, 0, sizeof(metrics_t));
+
+    for (side=0; side<ANZ_SIDES; ++side) {
+        sh = sides[side];
+        m->empty[side] = empty_side (sarr, side);
+        m->height[side] = highest (sarr, SHAPES_PER_SIDE,
+                sh[0], sh[1], sh[2], sh[3], sh[4]);
+        m->width[side] = widest (sarr, SHAPES_PER_SIDE,
+                sh[0], sh[1], sh[2], sh[3], sh[4]);
+    }
+
+    /*
+     *  Middle shapes of top and bottom, leftmost first. The top side is
+     *  specified from left to right, the bottom side from right to left.
+     */
+    for (i=1; i<SHAPES_PER_SIDE-1; ++i) {
+        if (!isempty (sarr + north_side[i]))
+            m->middle[BTOP][m->anz_middle[BTOP]++] = north_side[i];
+        if (!isempty (sarr + south_side[SHAPES_PER_SIDE-1-i]))
+            m->middle[BBOT][m->anz_middle[BBOT]++] = south_side[SHAPES_PER_SIDE-1-i];
+    }
+}
+
+
+
 /*EOF*/                                                 /* vim: set sw=4: */
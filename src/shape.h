@@ -57,6 +57,15 @@ typedef struct {
 #define SENTRY_INITIALIZER (sentry_t) {NULL, 0, 0, 0}
 
 
+typedef struct {                         /* set by measure_shapes() */
+    int     empty[ANZ_SIDES];            /* true if side is empty, see empty_side() */
+    size_t  height[ANZ_SIDES];           /* height of highest shape on side */
+    size_t  width[ANZ_SIDES];            /* width of widest shape on side */
+    shape_t middle[ANZ_SIDES][SHAPES_PER_SIDE-2];  /* non-empty middle shapes */
+    int     anz_middle[ANZ_SIDES];       /* of top and bottom, leftmost first */
+} metrics_t;
+
+
 
 int genshape (const size_t width, const size_t height, char ***chars);
 void freeshape (sentry_t *shape);
@@ -74,6 +83,8 @@ shape_t leftmost (const int aside, const int cnt);
 
 int empty_side (sentry_t *sarr, const int aside);
 
+void measure_shapes (sentry_t *sarr, metrics_t *m);
+
 
 
 #endif /*SHAPE_H*/
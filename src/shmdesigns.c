@@ -0,0 +1,758 @@
+/*
+ *  File:             shmdesigns.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 15:37h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Share parsed designs between processes via shared memory
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *  If the BOXES_SHM environment variable is set, the designs of a config
+ *  file are published in a POSIX shared memory segment the first time the
+ *  file is parsed. Further processes map the segment read-only instead of
+ *  parsing the file again. The segment is named after the user and the
+ *  absolute path of the config file, and is only accessible by that user.
+ *
+ *  The segment holds all designs of the config file, with all strings and
+ *  shape lines, but without pointers: references are offsets from the start
+ *  of the segment. A process which attaches the segment only needs to build
+ *  a few arrays of pointers into it.
+ *
+ *  The segment records the generation of the config file it was made from
+ *  (device, inode, size, and modification time, to the nanosecond where
+ *  available). When the config file has changed, the segment is stale, and
+ *  is replaced by the next process.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SHM_OPEN
+#include <sys/mman.h>
+#endif
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "lexer.h"
+#include "shmdesigns.h"
+
+
+
+extern FILE *yyin;                       /* lex input file */
+extern int yyparse();
+
+
+#ifdef HAVE_SHM_OPEN
+
+#define SHM_MAGIC    0x426f7844UL        /* "BoxD", set when segment is complete */
+#define SHM_VERSION  3                   /* of the segment layout */
+#define SHM_ALIGN    sizeof(size_t)      /* alignment of arrays in segment */
+
+
+typedef struct {                         /* identifies a version of a file */
+    unsigned long dev;
+    unsigned long ino;
+    unsigned long size;
+    unsigned long mtime;
+    unsigned long mtime_ns;              /* 0 if not available */
+} generation_t;
+
+
+typedef struct {                         /* start of segment */
+    unsigned long magic;
+    unsigned long version;
+    size_t        size;                  /* size of segment in bytes */
+    generation_t  gen;                   /* generation of config file */
+    size_t        designs;               /* offset of array of shm_design_t */
+    int           anz_designs;
+    size_t        anz_lines;             /* total number of shape lines */
+    size_t        anz_rules;             /* total number of rules */
+    size_t        anz_trims;             /* total number of trimmed variants */
+    size_t        anz_infos;             /* number of designs with metadata */
+} shm_header_t;
+
+
+typedef struct {                         /* a design; offset 0 means NULL */
+    size_t     name;
+    size_t     shape[ANZ_SHAPES];        /* offset of array of line offsets */
+    size_t     height[ANZ_SHAPES];
+    size_t     width[ANZ_SHAPES];
+    int        elastic[ANZ_SHAPES];
+    size_t     maxshapeheight;
+    size_t     minwidth;
+    size_t     minheight;
+    int        padding[ANZ_SIDES];
+    char       indentmode;
+    metrics_t  metrics;
+    size_t     reprules;                 /* offset of array of shm_rule_t */
+    size_t     anz_reprules;
+    size_t     revrules;
+    size_t     anz_revrules;
+    size_t     west_trims;               /* offset of array of shm_trim_t */
+    size_t     anz_west_trims;
+    size_t     east_trims;
+    size_t     anz_east_trims;
+    size_t     corner_trims;
+    size_t     anz_corner_trims[ANZ_CORNERS];
+    size_t     info;                     /* offset of array of 6 string offsets */
+} shm_design_t;
+
+
+typedef struct {
+    size_t search;
+    size_t repstr;
+    int    line;
+    char   mode;
+} shm_rule_t;
+
+
+typedef struct {
+    size_t text;                         /* offset within a shape line */
+    size_t len;
+    size_t lead;
+    size_t trail;
+} shm_trim_t;
+
+
+typedef struct {                         /* segment being built */
+    char  *buf;
+    size_t len;
+    size_t alloc;
+    int    failed;                       /* true if out of memory */
+} image_t;
+
+
+static const char *seg = NULL;           /* segment attached */
+static size_t      seg_size = 0;         /* size of segment */
+
+
+
+static size_t put (image_t *im, const void *data, const size_t len)
+/*
+ *  Append len bytes of data to the image, aligned to SHM_ALIGN.
+ *
+ *  RETURNS:  offset of the data in the image (0 if out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t off = (im->len + SHM_ALIGN - 1) / SHM_ALIGN * SHM_ALIGN;
+    size_t n;
+    char  *tmp;
+
+    if (im->failed)
+        return 0;
+    if (off + len > im->alloc) {
+        n = im->alloc? 2 * im->alloc: 64 * 1024;
+        while (n < off + len)
+            n *= 2;
+        tmp = (char *) realloc (im->buf, n);
+        if (tmp == NULL) {
+            im->failed = 1;
+            return 0;
+        }
+        im->buf = tmp;
+        im->alloc = n;
+    }
+    memset (im->buf + im->len, 0, off - im->len);
+    memcpy (im->buf + off, data, len);
+    im->len = off + len;
+    return off;
+}
+
+
+
+static size_t put_str (image_t *im, const char *s)
+{
+    return s? put (im, s, strlen (s) + 1): 0;
+}
+
+
+
+static int put_design (image_t *im, shm_header_t *hdr, const design_t *d,
+                       shm_design_t *rec)
+/*
+ *  Append the strings and arrays of design d to the image, and fill in its
+ *  entry rec, which refers to them.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (out of memory, or design not consistent)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t     *lines[ANZ_SHAPES];       /* offsets of the shape lines */
+    shm_rule_t *rules = NULL;
+    shm_trim_t *trims = NULL;
+    size_t      info[6];
+    size_t      k, l;
+    size_t      anz_corners = 0;
+    int         j;
+    int         rc = 1;
+
+    memset (rec, 0, sizeof(shm_design_t));
+    memset (lines, 0, sizeof(lines));
+    rec->name = put_str (im, d->name);
+
+    for (j=0; j<ANZ_SHAPES; ++j) {
+        rec->height[j] = d->shape[j].height;
+        rec->width[j] = d->shape[j].width;
+        rec->elastic[j] = d->shape[j].elastic;
+        if (d->shape[j].chars == NULL)
+            continue;
+        lines[j] = (size_t *) malloc (d->shape[j].height * sizeof(size_t) + 1);
+        if (lines[j] == NULL)
+            goto done;
+        for (k=0; k<d->shape[j].height; ++k)
+            lines[j][k] = put_str (im, d->shape[j].chars[k]);
+        rec->shape[j] = put (im, lines[j], d->shape[j].height * sizeof(size_t));
+        hdr->anz_lines += d->shape[j].height;
+    }
+
+    rec->maxshapeheight = d->maxshapeheight;
+    rec->minwidth = d->minwidth;
+    rec->minheight = d->minheight;
+    memcpy (rec->padding, d->padding, sizeof(rec->padding));
+    rec->indentmode = d->indentmode;
+    rec->metrics = d->metrics;
+
+    l = d->anz_reprules > d->anz_revrules? d->anz_reprules: d->anz_revrules;
+    rules = (shm_rule_t *) calloc (l + 1, sizeof(shm_rule_t));
+    for (j=0; j<ANZ_CORNERS; ++j)
+        anz_corners += d->anz_corner_trims[j];
+    l = d->anz_west_trims > d->anz_east_trims? d->anz_west_trims: d->anz_east_trims;
+    l = l > anz_corners? l: anz_corners;
+    trims = (shm_trim_t *) calloc (l + 1, sizeof(shm_trim_t));
+    if (rules == NULL || trims == NULL)
+        goto done;
+
+    for (k=0; k<d->anz_reprules; ++k) {
+        rules[k].search = put_str (im, d->reprules[k].search);
+        rules[k].repstr = put_str (im, d->reprules[k].repstr);
+        rules[k].line = d->reprules[k].line;
+        rules[k].mode = d->reprules[k].mode;
+    }
+    if (d->anz_reprules)
+        rec->reprules = put (im, rules, d->anz_reprules * sizeof(shm_rule_t));
+    rec->anz_reprules = d->anz_reprules;
+
+    for (k=0; k<d->anz_revrules; ++k) {
+        rules[k].search = put_str (im, d->revrules[k].search);
+        rules[k].repstr = put_str (im, d->revrules[k].repstr);
+        rules[k].line = d->revrules[k].line;
+        rules[k].mode = d->revrules[k].mode;
+    }
+    if (d->anz_revrules)
+        rec->revrules = put (im, rules, d->anz_revrules * sizeof(shm_rule_t));
+    rec->anz_revrules = d->anz_revrules;
+    hdr->anz_rules += d->anz_reprules + d->anz_revrules;
+
+    /*
+     *  Trimmed variants point into the shape lines, so they are stored as
+     *  offsets within the copies of those lines.
+     */
+    for (l=0; l<3; ++l) {
+        const trimmed_t *t = l == 2? d->corner_trims: l? d->east_trims: d->west_trims;
+        size_t           anz = l == 2? anz_corners: l? d->anz_east_trims: d->anz_west_trims;
+
+        for (k=0; k<anz; ++k) {
+            size_t m;
+            trims[k].text = 0;
+            for (j=0; trims[k].text == 0 && j<ANZ_SHAPES; ++j) {
+                for (m=0; m<d->shape[j].height; ++m) {
+                    const char *s = d->shape[j].chars[m];
+                    if (t[k].text >= s && t[k].text < s + d->shape[j].width) {
+                        trims[k].text = lines[j][m] + (t[k].text - s);
+                        break;
+                    }
+                }
+            }
+            if (trims[k].text == 0)
+                goto done;
+            trims[k].len = t[k].len;
+            trims[k].lead = t[k].lead;
+            trims[k].trail = t[k].trail;
+        }
+        if (anz && l == 2)
+            rec->corner_trims = put (im, trims, anz * sizeof(shm_trim_t));
+        else if (anz && l)
+            rec->east_trims = put (im, trims, anz * sizeof(shm_trim_t));
+        else if (anz)
+            rec->west_trims = put (im, trims, anz * sizeof(shm_trim_t));
+        hdr->anz_trims += anz;
+    }
+    rec->anz_west_trims = d->anz_west_trims;
+    rec->anz_east_trims = d->anz_east_trims;
+    memcpy (rec->anz_corner_trims, d->anz_corner_trims, sizeof(rec->anz_corner_trims));
+
+    if (d->info) {
+        info[0] = put_str (im, d->info->author);
+        info[1] = put_str (im, d->info->designer);
+        info[2] = put_str (im, d->info->created);
+        info[3] = put_str (im, d->info->revision);
+        info[4] = put_str (im, d->info->revdate);
+        info[5] = put_str (im, d->info->sample);
+        rec->info = put (im, info, sizeof(info));
+        ++(hdr->anz_infos);
+    }
+    rc = 0;
+
+done:
+    for (j=0; j<ANZ_SHAPES; ++j)
+        BFREE (lines[j]);
+    BFREE (rules);
+    BFREE (trims);
+    return rc || im->failed;
+}
+
+
+
+static void publish (const char *name, const generation_t *gen)
+/*
+ *  Publish the designs in a new shared memory segment name, replacing any
+ *  stale segment of that name. The magic number is written last, so other
+ *  processes never use a segment which is not complete.
+ *
+ *  Errors are ignored, as the segment is only an optimization.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    image_t       im = { NULL, 0, 0, 0 };
+    shm_header_t  hdr;
+    shm_design_t *recs;
+    char         *p;
+    int           fd;
+    int           i;
+
+    recs = (shm_design_t *) malloc ((anz_designs + 1) * sizeof(shm_design_t));
+    if (recs == NULL)
+        return;
+    memset (&hdr, 0, sizeof(hdr));
+    put (&im, &hdr, sizeof(hdr));        /* so that offset 0 is never data */
+    for (i=0; i<anz_designs; ++i) {
+        if (put_design (&im, &hdr, designs + i, recs + i)) {
+            BFREE (recs);
+            BFREE (im.buf);
+            return;
+        }
+    }
+    hdr.designs = put (&im, recs, anz_designs * sizeof(shm_design_t));
+    BFREE (recs);
+    if (im.failed) {
+        BFREE (im.buf);
+        return;
+    }
+    hdr.version = SHM_VERSION;
+    hdr.size = im.len;
+    hdr.gen = *gen;
+    hdr.anz_designs = anz_designs;
+    memcpy (im.buf, &hdr, sizeof(hdr));
+
+    shm_unlink (name);                   /* processes using it keep it */
+    fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {                        /* another process was quicker */
+        BFREE (im.buf);
+        return;
+    }
+    p = MAP_FAILED;
+    if (ftruncate (fd, (off_t) im.len) == 0)
+        p = (char *) mmap (NULL, im.len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED) {
+        shm_unlink (name);
+        BFREE (im.buf);
+        return;
+    }
+    memcpy (p, im.buf, im.len);
+    ((shm_header_t *) p)->magic = SHM_MAGIC;
+    munmap (p, im.len);
+    BFREE (im.buf);
+
+    #ifdef DEBUG
+        fprintf (stderr, "Published %d designs in shared memory %s (%lu bytes).\n",
+                anz_designs, name, (unsigned long) hdr.size);
+    #endif
+}
+
+
+
+static char *seg_str (const size_t off)
+/*
+ *  Return the string at offset off of the segment attached, which must lie
+ *  within the segment.
+ *
+ *  RETURNS:  the string, or NULL if off is 0 or invalid
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (off == 0 || off >= seg_size || memchr (seg + off, '\0', seg_size - off) == NULL)
+        return NULL;
+    return (char *) seg + off;
+}
+
+
+
+static const void *seg_array (const size_t off, const size_t anz, const size_t size)
+/*
+ *  Return the array of anz elements of size bytes at offset off of the
+ *  segment attached, which must lie within the segment.
+ *
+ *  RETURNS:  the array, or NULL if off is 0 or invalid
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (off == 0 || off % SHM_ALIGN != 0 || off >= seg_size
+            || anz > (seg_size - off) / size)
+        return NULL;
+    return seg + off;
+}
+
+
+
+static int attach_designs (const shm_header_t *hdr)
+/*
+ *  Make the designs in the attached segment the current designs. Only the
+ *  arrays of pointers are allocated; the strings are used in place.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error (segment invalid, or out of memory)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const shm_design_t *recs;
+    const shm_design_t *r;
+    design_t      *res;
+    design_t      *d;
+    char         **lines;
+    reprule_t     *rules;
+    trimmed_t     *trims;
+    designinfo_t  *infos;
+    size_t         nl = 0, nr = 0, nt = 0, ni = 0;
+    size_t         k;
+    int            i, j;
+
+    recs = (const shm_design_t *) seg_array (hdr->designs, hdr->anz_designs,
+            sizeof(shm_design_t));
+    if (recs == NULL || hdr->anz_designs <= 0
+            || hdr->anz_lines > seg_size || hdr->anz_rules > seg_size
+            || hdr->anz_trims > seg_size || hdr->anz_infos > seg_size)
+        return 1;
+
+    res = (design_t *) calloc (hdr->anz_designs, sizeof(design_t));
+    lines = (char **) malloc ((hdr->anz_lines + 1) * sizeof(char *));
+    rules = (reprule_t *) calloc (hdr->anz_rules + 1, sizeof(reprule_t));
+    trims = (trimmed_t *) malloc ((hdr->anz_trims + 1) * sizeof(trimmed_t));
+    infos = (designinfo_t *) malloc ((hdr->anz_infos + 1) * sizeof(designinfo_t));
+    if (res == NULL || lines == NULL || rules == NULL || trims == NULL
+            || infos == NULL)
+        goto failed;
+
+    for (i=0, r=recs, d=res; i<hdr->anz_designs; ++i, ++r, ++d) {
+        d->name = seg_str (r->name);
+        if (d->name == NULL)
+            goto failed;
+
+        for (j=0; j<ANZ_SHAPES; ++j) {
+            const size_t *offs;
+            d->shape[j].height = r->height[j];
+            d->shape[j].width = r->width[j];
+            d->shape[j].elastic = r->elastic[j];
+            if (r->shape[j] == 0)
+                continue;
+            offs = (const size_t *) seg_array (r->shape[j], r->height[j], sizeof(size_t));
+            if (offs == NULL || r->height[j] > hdr->anz_lines - nl)
+                goto failed;
+            d->shape[j].chars = lines + nl;
+            for (k=0; k<r->height[j]; ++k) {
+                lines[nl] = seg_str (offs[k]);
+                if (lines[nl] == NULL)
+                    goto failed;
+                ++nl;
+            }
+        }
+
+        d->maxshapeheight = r->maxshapeheight;
+        d->minwidth = r->minwidth;
+        d->minheight = r->minheight;
+        memcpy (d->padding, r->padding, sizeof(d->padding));
+        d->indentmode = r->indentmode;
+        d->metrics = r->metrics;
+
+        for (j=0; j<2; ++j) {
+            size_t            off = j? r->revrules: r->reprules;
+            size_t            anz = j? r->anz_revrules: r->anz_reprules;
+            const shm_rule_t *sr;
+            if (anz == 0)
+                continue;
+            sr = (const shm_rule_t *) seg_array (off, anz, sizeof(shm_rule_t));
+            if (sr == NULL || anz > hdr->anz_rules - nr)
+                goto failed;
+            if (j) {
+                d->revrules = rules + nr;
+                d->anz_revrules = anz;
+            }
+            else {
+                d->reprules = rules + nr;
+                d->anz_reprules = anz;
+            }
+            for (k=0; k<anz; ++k, ++nr) {
+                rules[nr].search = seg_str (sr[k].search);
+                rules[nr].repstr = seg_str (sr[k].repstr);
+                rules[nr].prog = NULL;   /* compiled when first used */
+                rules[nr].line = sr[k].line;
+                rules[nr].mode = sr[k].mode;
+                if (rules[nr].search == NULL || rules[nr].repstr == NULL)
+                    goto failed;
+            }
+        }
+
+        for (j=0; j<3; ++j) {
+            size_t            off = j == 2? r->corner_trims: j? r->east_trims: r->west_trims;
+            size_t            anz = j == 2? 0: j? r->anz_east_trims: r->anz_west_trims;
+            const shm_trim_t *st;
+            if (j == 2) {
+                for (k=0; k<ANZ_CORNERS; ++k) {
+                    if (r->anz_corner_trims[k] > hdr->anz_trims)
+                        goto failed;
+                    anz += r->anz_corner_trims[k];
+                }
+            }
+            if (anz == 0)
+                continue;
+            st = (const shm_trim_t *) seg_array (off, anz, sizeof(shm_trim_t));
+            if (st == NULL || anz > hdr->anz_trims - nt)
+                goto failed;
+            if (j == 2) {
+                d->corner_trims = trims + nt;
+                memcpy (d->anz_corner_trims, r->anz_corner_trims,
+                        sizeof(d->anz_corner_trims));
+            }
+            else if (j) {
+                d->east_trims = trims + nt;
+                d->anz_east_trims = anz;
+            }
+            else {
+                d->west_trims = trims + nt;
+                d->anz_west_trims = anz;
+            }
+            for (k=0; k<anz; ++k, ++nt) {
+                if (st[k].text == 0 || st[k].text >= seg_size
+                        || st[k].len > seg_size - st[k].text)
+                    goto failed;
+                trims[nt].text = (char *) seg + st[k].text;
+                trims[nt].len = st[k].len;
+                trims[nt].lead = st[k].lead;
+                trims[nt].trail = st[k].trail;
+            }
+        }
+
+        if (r->info) {
+            const size_t *info = (const size_t *) seg_array (r->info, 6, sizeof(size_t));
+            if (info == NULL || ni >= hdr->anz_infos)
+                goto failed;
+            infos[ni].author = seg_str (info[0]);
+            infos[ni].designer = seg_str (info[1]);
+            infos[ni].created = seg_str (info[2]);
+            infos[ni].revision = seg_str (info[3]);
+            infos[ni].revdate = seg_str (info[4]);
+            infos[ni].sample = seg_str (info[5]);
+            d->info = infos + ni;
+            ++ni;
+        }
+    }
+
+    designs = res;
+    anz_designs = hdr->anz_designs;
+    design_idx = anz_designs - 1;
+    return 0;
+
+failed:
+    BFREE (res);
+    BFREE (lines);
+    BFREE (rules);
+    BFREE (trims);
+    BFREE (infos);
+    return 1;
+}
+
+
+
+static int attach (const char *name, const generation_t *gen)
+/*
+ *  Attach the shared memory segment name read-only, and use its designs.
+ *  The segment must be owned by the current user, and must have been made
+ *  from the current generation of the config file.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   no such segment, or segment invalid or stale
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    const shm_header_t *hdr;
+    struct stat         st;
+    void               *p;
+    int                 fd;
+
+    fd = shm_open (name, O_RDONLY, 0);
+    if (fd < 0)
+        return 1;
+    if (fstat (fd, &st) || st.st_uid != geteuid() || (st.st_mode & 077) != 0
+            || (size_t) st.st_size < sizeof(shm_header_t))
+    {
+        close (fd);
+        return 1;
+    }
+    p = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+        return 1;
+
+    seg = (const char *) p;
+    seg_size = (size_t) st.st_size;
+    hdr = (const shm_header_t *) p;
+    if (hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION
+            || hdr->size != seg_size
+            || memcmp (&(hdr->gen), gen, sizeof(generation_t)) != 0
+            || attach_designs (hdr))
+    {
+        #ifdef DEBUG
+            fprintf (stderr, "Shared memory %s is stale or invalid.\n", name);
+        #endif
+        munmap (p, seg_size);
+        seg = NULL;
+        seg_size = 0;
+        return 1;
+    }
+
+    #ifdef DEBUG
+        fprintf (stderr, "Attached %d designs from shared memory %s.\n",
+                anz_designs, name);
+    #endif
+    return 0;
+}
+
+
+
+static int segment_name (char *name, generation_t *gen)
+/*
+ *  Determine the name of the shared memory segment of the config file
+ *  yyfilename, and the generation of the config file yyin.
+ *
+ *    name   RESULT: the segment name, at least 32 characters
+ *    gen    RESULT: the generation
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   config file cannot be identified
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char          path[PATH_MAX];
+    struct stat   st;
+    unsigned long h = 2166136261UL;
+    const char   *p;
+
+    if (yyin == NULL || yyfilename == NULL || fstat (fileno (yyin), &st)
+            || !S_ISREG (st.st_mode) || realpath (yyfilename, path) == NULL)
+        return 1;
+
+    for (p=path; *p; ++p) {              /* FNV-1a */
+        h ^= (unsigned char) *p;
+        h = (h * 16777619UL) & 0xffffffffUL;
+    }
+    sprintf (name, "/boxes-%lu-%08lx", (unsigned long) geteuid(), h);
+
+    memset (gen, 0, sizeof(generation_t));
+    gen->dev = (unsigned long) st.st_dev;
+    gen->ino = (unsigned long) st.st_ino;
+    gen->size = (unsigned long) st.st_size;
+    gen->mtime = (unsigned long) st.st_mtime;
+    #ifdef HAVE_ST_MTIM
+        gen->mtime_ns = (unsigned long) st.st_mtim.tv_nsec;
+    #endif
+    return 0;
+}
+
+#endif /* HAVE_SHM_OPEN */
+
+
+
+int shm_load_designs()
+/*
+ *  Get the designs of the config file yyfilename, which is open as yyin,
+ *  from its shared memory segment. If there is no such segment, or it is
+ *  stale, all designs are parsed from the config file and published in a
+ *  new segment.
+ *
+ *  RETURNS:  == 0   success, designs are set
+ *            != 0   error (config file invalid)
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    #ifdef HAVE_SHM_OPEN
+        char         name[64];
+        generation_t gen;
+        opt_t        saved_opt;
+        int          rc;
+
+        if (segment_name (name, &gen))
+            return yyparse();
+        if (attach (name, &gen) == 0)
+            return 0;
+
+        /*
+         *  Parse all designs, with metadata, as for a listing.
+         */
+        saved_opt = opt;
+        opt.l = 1;
+        opt.design_choice_by_user = 0;
+        rc = yyparse();
+        opt = saved_opt;
+        if (rc == 0) {
+            publish (name, &gen);
+            return 0;
+        }
+
+        /*
+         *  An error in a design which is not needed must not make us fail,
+         *  so parse again as usual.
+         */
+        designs = NULL;
+        anz_designs = 0;
+        rewind (yyin);
+        lexer_restart (yyin);
+    #endif
+
+    return yyparse();
+}
+
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
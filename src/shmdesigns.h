@@ -0,0 +1,35 @@
+/*
+ *  File:             shmdesigns.h
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 15:37h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Share parsed designs between processes via shared memory
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#ifndef SHMDESIGNS_H
+#define SHMDESIGNS_H
+
+
+int shm_load_designs();
+
+
+#endif /*SHMDESIGNS_H*/
+
+/*EOF*/                                          /* vim: set cindent sw=4: */
@@ -0,0 +1,267 @@
+/*
+ *  File:             spool.c
+ *  Project Main:     boxes.c
+ *  Date created:     October 19, 2026 (Monday, 13:47h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Temporary storage of input lines for very large input
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "shape.h"
+#include "boxes.h"
+#include "tools.h"
+#include "spool.h"
+
+
+
+static THREAD_LOCAL FILE  *spoolfile = NULL;   /* temporary file holding the lines */
+static THREAD_LOCAL size_t spoolstrip = 0;     /* leading spaces to remove on read */
+
+
+
+int spool_open()
+/*
+ *  Create a new, empty spool file. A previously opened spool file is
+ *  closed and discarded.
+ *
+ *  The spool file is deleted automatically when it is closed or when the
+ *  program terminates.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    spool_close();
+    spoolfile = tmpfile();
+    if (spoolfile == NULL) {
+        perror (PROJECT);
+        return 1;
+    }
+    spoolstrip = 0;
+    return 0;
+}
+
+
+
+static int write_line (FILE *f, const line_t *line)
+/*
+ *  Write one line to the given file in binary form, including its tab
+ *  positions, so that it can be read back exactly as it was written.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (fwrite (&(line->len), sizeof(size_t), 1, f) != 1
+     || fwrite (&(line->tabpos_len), sizeof(size_t), 1, f) != 1
+     || (line->tabpos_len > 0 && fwrite (line->tabpos, sizeof(size_t),
+                 line->tabpos_len, f) != line->tabpos_len)
+     || (line->len > 0 && fwrite (line->text, 1, line->len, f) != line->len))
+    {
+        perror (PROJECT);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+int spool_write (const line_t *line)
+/*
+ *  Append one line to the spool file.
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (spoolfile == NULL) {
+        fprintf (stderr, "%s: internal error\n", PROJECT);
+        return 1;
+    }
+    return write_line (spoolfile, line);
+}
+
+
+
+int spool_rewind (const size_t strip)
+/*
+ *  Prepare for reading the spool file from the beginning.
+ *
+ *    strip   number of leading spaces to remove from each line upon
+ *            reading (i.e. text indentation which is not retained)
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (spoolfile == NULL) {
+        fprintf (stderr, "%s: internal error\n", PROJECT);
+        return 1;
+    }
+    if (fflush (spoolfile) || fseek (spoolfile, 0L, SEEK_SET)) {
+        perror (PROJECT);
+        return 1;
+    }
+    spoolstrip = strip;
+    return 0;
+}
+
+
+
+int spool_read (line_t *line)
+/*
+ *  Read the next line from the spool file.
+ *
+ *    line   RESULT: the line read (memory is allocated for text and tabpos)
+ *
+ *  RETURNS:  == 0   success
+ *             < 0   no more lines
+ *             > 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    memset (line, 0, sizeof(line_t));
+
+    if (fread (&(line->len), sizeof(size_t), 1, spoolfile) != 1) {
+        if (feof (spoolfile))
+            return -1;
+        perror (PROJECT);
+        return 2;
+    }
+    if (fread (&(line->tabpos_len), sizeof(size_t), 1, spoolfile) != 1)
+        goto err;
+
+    if (line->tabpos_len > 0) {
+        line->tabpos = (size_t *) calloc (line->tabpos_len + 1, sizeof(size_t));
+        if (line->tabpos == NULL) {
+            perror (PROJECT);
+            return 2;
+        }
+        if (fread (line->tabpos, sizeof(size_t), line->tabpos_len, spoolfile)
+                != line->tabpos_len)
+            goto err;
+    }
+
+    line->text = (char *) malloc (line->len + 1);
+    if (line->text == NULL) {
+        perror (PROJECT);
+        BFREE (line->tabpos);
+        return 2;
+    }
+    if (line->len > 0 && fread (line->text, 1, line->len, spoolfile) != line->len)
+        goto err;
+    line->text[line->len] = '\0';
+
+    /*
+     *  Remove indentation
+     */
+    if (spoolstrip > 0 && line->len >= spoolstrip) {
+        memmove (line->text, line->text + spoolstrip, line->len - spoolstrip + 1);
+        line->len -= spoolstrip;
+    }
+
+    return 0;
+
+err:
+    fprintf (stderr, "%s: error reading spool file\n", PROJECT);
+    BFREE (line->text);
+    BFREE (line->tabpos);
+    return 2;
+}
+
+
+
+int spool_rewrite (int (*func)(line_t *line))
+/*
+ *  Replace the contents of the spool file by the result of applying func
+ *  to each line read from it. Lines are read starting from the current
+ *  position as set by spool_rewind(). Afterwards, the spool file is ready
+ *  for reading from the beginning again. On error, the spool file is left
+ *  as it was.
+ *
+ *    func   function which modifies the given line, returning != 0 on error
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    FILE  *newfile;
+    line_t line;
+    int    rc;
+
+    newfile = tmpfile();
+    if (newfile == NULL) {
+        perror (PROJECT);
+        return 1;
+    }
+
+    while ((rc = spool_read (&line)) == 0) {
+        if (func (&line) || write_line (newfile, &line))
+            rc = 1;
+        BFREE (line.text);
+        BFREE (line.tabpos);
+        if (rc)
+            break;
+    }
+    if (rc > 0 || fflush (newfile)) {
+        if (rc <= 0)
+            perror (PROJECT);
+        fclose (newfile);
+        return 1;
+    }
+
+    fclose (spoolfile);
+    spoolfile = newfile;
+    return spool_rewind (0);
+}
+
+
+
+void spool_close()
+/*
+ *  Close and discard the spool file, if any.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    if (spoolfile != NULL) {
+        fclose (spoolfile);
+        spoolfile = NULL;
+    }
+}
+
+
+
+/*EOF*/                                                 /* vim: set sw=4: */
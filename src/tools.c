@@ -253,7 +253,7 @@ size_t expand_tabs_into (const char *input_buffer, const size_t in_len,
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-   static char temp [LINE_MAX*MAX_TABSTOP+1];  /* work string */
+   static THREAD_LOCAL char temp [LINE_MAX*MAX_TABSTOP+1];  /* work string */
    size_t ii;                            /* position in input string */
    size_t io;                            /* position in work string */
    size_t jp;                            /* tab expansion jump point */
@@ -326,14 +326,26 @@ char *my_strnrstr (const char *s1, const char *s2, const size_t s2_len, int skip
  *      s2_len   length in characters of s2
  *      skip     number of finds to ignore before returning anything
  *
+ *  This is a Boyer-Moore-Horspool search running from right to left. The
+ *  shift is taken from the text character under the first position of the
+ *  pattern: it is the distance to the leftmost occurrence of that character
+ *  in the rest of the pattern. No match can start after the last occurrence
+ *  of the first pattern character, which strrchr() finds quickly. Before
+ *  comparing a whole window, its last and first characters are checked.
+ *  Overlapping finds are counted for skip.
+ *
  *  RETURNS: pointer to last occurrence of string s2 in string s1
  *           NULL if not found or error
  *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 {
-    char *p;
-    int comp;
+    unsigned char shift[256];            /* bad character shifts, max. 255 */
+    int           have_shift = 0;        /* true if shift[] was initialized */
+    const char   *p;
+    const char   *last;                  /* last char of pattern */
+    size_t        rest;                  /* length of s1 from p */
+    size_t        j;
 
     if (!s2 || *s2 == '\0')
         return (char *) s1;
@@ -346,17 +358,45 @@ char *my_strnrstr (const char *s1, const char *s2, const size_t s2_len, int skip
     if (!p)
         return NULL;
 
-    while (p >= s1) {
-        comp = strncmp (p, s2, s2_len);
-        if (comp == 0) {
-            if (skip--)
-                --p;
-            else
-                return p;
+    if (s2_len == 1) {
+        for (; p >= s1; --p) {
+            if (*p == *s2 && skip-- == 0)
+                return (char *) p;
         }
-        else {
-            --p;
+        return NULL;
+    }
+
+    rest = strlen (p);
+    if (rest < s2_len) {
+        if ((size_t) (p - s1) < s2_len - rest)
+            return NULL;
+        p -= s2_len - rest;
+    }
+
+    last = s2 + s2_len - 1;
+    for (;;) {
+        if (p[s2_len-1] == *last && *p == *s2
+                && memcmp (p+1, s2+1, s2_len-2) == 0)
+        {
+            if (skip-- == 0)
+                return (char *) p;
+            if (p == s1)
+                break;
+            --p;                         /* finds may overlap */
+            continue;
+        }
+        if (!have_shift) {               /* not needed for an immediate find */
+            memset (shift, s2_len > 255? 255: (int) s2_len, sizeof(shift));
+            for (j=s2_len-1; j>0; --j) {
+                if (j < 255)
+                    shift[(unsigned char) s2[j]] = (unsigned char) j;
+            }
+            have_shift = 1;
         }
+        j = shift[(unsigned char) *p];
+        if ((size_t) (p - s1) < j)
+            break;
+        p -= j;
     }
 
     return NULL;
@@ -364,13 +404,13 @@ char *my_strnrstr (const char *s1, const char *s2, const size_t s2_len, int skip
 
 
 
-char *tabbify_indent (const size_t lineno, char *indentspc, const size_t indentspc_len)
+char *tabbify_indent (const line_t *line, char *indentspc, const size_t indentspc_len)
 /*
  *  Checks if tab expansion mode is "keep", and if so, calculates a new
  *  indentation string based on the one given. The new string contains
  *  tabs in their original positions.
  *
- *    lineno         index of the input line we are referring to
+ *    line           the input line we are referring to (may be NULL)
  *    indentspc      previously calculated "space-only" indentation string
  *                   (may be NULL). This is only used when opt.tabexp != 'k',
  *                   in which case it will be used as the function result.
@@ -389,7 +429,7 @@ char *tabbify_indent (const size_t lineno, char *indentspc, const size_t indents
     if (opt.tabexp != 'k') {
         return indentspc;
     }
-    if (lineno >= input.anz_lines) {
+    if (line == NULL) {
         return NULL;
     }
     if (indentspc_len == 0) {
@@ -405,10 +445,9 @@ char *tabbify_indent (const size_t lineno, char *indentspc, const size_t indents
     result[indentspc_len] = '\0';
     result_len = indentspc_len;
     
-    for (i=0; i < input.lines[lineno].tabpos_len
-            && input.lines[lineno].tabpos[i] < indentspc_len; ++i)
+    for (i=0; i < line->tabpos_len && line->tabpos[i] < indentspc_len; ++i)
     {
-        size_t tpos = input.lines[lineno].tabpos[i];
+        size_t tpos = line->tabpos[i];
         size_t nspc = opt.tabstop - (tpos % opt.tabstop);   /* no of spcs covered by tab */
         if (tpos + nspc > input.indent) {
             break;
@@ -422,5 +461,42 @@ char *tabbify_indent (const size_t lineno, char *indentspc, const size_t indents
 }
 
 
+int hash_file (FILE *f, unsigned long *hash, unsigned long *size)
+/*
+ *  Compute the FNV-1a hash of the rest of file f. The file is left at its
+ *  end.
+ *
+ *    f      file to read from the current position on
+ *    hash   RESULT: the hash
+ *    size   RESULT: the number of bytes read
+ *
+ *  RETURNS:  == 0   success
+ *            != 0   read error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char          buf[8192];
+    unsigned long h = 2166136261UL;
+    unsigned long n = 0;
+    size_t        len;
+    size_t        i;
+
+    while ((len = fread (buf, 1, sizeof(buf), f)) > 0) {
+        for (i=0; i<len; ++i) {
+            h ^= (unsigned char) buf[i];
+            h = (h * 16777619UL) & 0xffffffffUL;
+        }
+        n += len;
+    }
+    if (ferror (f))
+        return 1;
+
+    *hash = h;
+    *size = n;
+    return 0;
+}
+
+
 
 /*EOF*/                                                  /* vim: set sw=4: */
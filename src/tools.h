@@ -29,6 +29,7 @@
 
 
 #define BMAX(a,b) ((a)>(b)? (a):(b))     /* return the larger value */
+#define BMIN(a,b) ((a)<(b)? (a):(b))     /* return the smaller value */
 
 #define BFREE(p) {                       /* free memory and clear pointer */ \
    if (p) {           \
@@ -51,7 +52,9 @@ int strisno (const char *s);
 
 void concat_strings (char *dst, int max_len, int count, ...);
 
-char *tabbify_indent (const size_t lineno, char *indentspc, const size_t indentspc_len);
+char *tabbify_indent (const line_t *line, char *indentspc, const size_t indentspc_len);
+
+int hash_file (FILE *f, unsigned long *hash, unsigned long *size);
 
 #endif
 
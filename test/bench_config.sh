@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+#
+# Config file scaling benchmark for boxes.
+#
+# File:             bench_config.sh
+# Date created:     October 19, 2026 (Monday, 15:16h)
+# Author:           agent <agent@local>
+# _____________________________________________________________________
+#
+# Generates config files with growing numbers of synthetic designs and
+# measures how long boxes takes to load and list them (-l). The time per
+# design should stay about the same as the files get larger.
+#
+# Usage: bench_config.sh [count ...]     default: 10000 25000 50000 100000
+
+if [ ${PWD##*/} != "test" ]; then
+    >&2 echo "Please run this script from the test folder."
+    exit 2
+fi
+if [ ! -x ../src/boxes ]; then
+    >&2 echo "Please build boxes first."
+    exit 2
+fi
+
+declare -a counts=("$@")
+if [ ${#counts[@]} -eq 0 ]; then
+    counts=(10000 25000 50000 100000)
+fi
+
+declare -r cfg=$(mktemp)
+trap 'rm -f $cfg' EXIT
+
+declare -i n
+for n in "${counts[@]}"; do
+    awk -v n=$n 'BEGIN {
+        for (i = 1; i <= n; ++i) {
+            printf "BOX bench%06d\n", i
+            printf "author \"bench_config.sh\"\n"
+            printf "sample\n    -------\n    x text\nends\n"
+            printf "shapes { w (\"x\") n (\"-\") }\n"
+            printf "elastic (n, w)\n"
+            printf "END bench%06d\n\n", i
+        }
+    }' > $cfg
+
+    declare -i start=$(date +%s%N)
+    ../src/boxes -f $cfg -l > /dev/null
+    if [ $? -ne 0 ]; then
+        >&2 echo "boxes failed on $n designs."
+        exit 1
+    fi
+    declare -i elapsed=$(( ($(date +%s%N) - start) / 1000 ))
+    awk -v n=$n -v us=$elapsed 'BEGIN {
+        printf "%7d designs: %8d ms, %6.2f us per design\n", n, us / 1000, us / n
+    }'
+done
+
+exit 0
+
+#EOF
@@ -0,0 +1,284 @@
+/*
+ *  File:             libtest.c
+ *  Date created:     October 19, 2026 (Monday, 15:53h)
+ *  Author:           Copyright (C) 2026 agent <agent@local>
+ *  Language:         ANSI C
+ *  Web Site:         http://boxes.thomasjensen.com/
+ *  Purpose:          Tests of the boxes library (libboxes.a)
+ *
+ *  License: o This program is free software; you can redistribute it and/or
+ *             modify it under the terms of the GNU General Public License as
+ *             published by the Free Software Foundation; either version 2 of
+ *             the License, or (at your option) any later version.
+ *           o This program is distributed in the hope that it will be useful,
+ *             but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *             MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *             GNU General Public License for more details.
+ *           o You should have received a copy of the GNU General Public
+ *             License along with this program; if not, write to the Free
+ *             Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ *             MA 02111-1307  USA
+ *
+ *  Built and run by "make test" from the test folder, after the library
+ *  has been built. Each test prints its name and OK or FAILED, and the exit
+ *  status is the number of failed tests.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "libboxes.h"
+
+
+#define CONFIG_FILE  "../boxes-config"
+#define ROUNDS       200                 /* per thread */
+
+
+static const char tiny_config[] =
+    "BOX tiny\n"
+    "sample\n"
+    "    +--+\n"
+    "    |x |\n"
+    "    +--+\n"
+    "ends\n"
+    "shapes {\n"
+    "    nw (\"+\") n (\"-\") ne (\"+\")\n"
+    "    w  (\"|\")         e  (\"|\")\n"
+    "    sw (\"+\") s (\"-\") se (\"+\")\n"
+    "}\n"
+    "elastic (n, e, s, w)\n"
+    "END tiny\n";
+
+static const char tiny_text[] = "hi\n";
+static const char tiny_box[]  = "+--+\n|hi|\n+--+\n";
+
+static const char text[] = "Hello, world!\n  second line\n\nlast\n";
+
+static int failed = 0;
+
+
+
+static void report (const char *name, const int ok)
+{
+    printf ("    %-40s %s\n", name, ok? "OK": "FAILED");
+    if (!ok)
+        ++failed;
+}
+
+
+
+static char *run (boxes_t *ctx, const int mode, const char *s)
+/*
+ *  Draw ('d') or remove ('r') the box of s, growing the output buffer as
+ *  requested by the library.
+ *
+ *  RETURNS:  the result (to be freed), or NULL on error
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    size_t size = 16;
+    size_t len;
+    char  *out = NULL;
+    int    rc;
+
+    do {
+        free (out);
+        out = (char *) malloc (size);
+        if (out == NULL)
+            return NULL;
+        len = size;
+        if (mode == 'd')
+            rc = boxes_draw (ctx, s, strlen (s), out, &len);
+        else
+            rc = boxes_remove (ctx, s, strlen (s), out, &len);
+        size = len;
+    } while (rc == BOXES_TOOSMALL);
+
+    if (rc != BOXES_OK || strlen (out) != len) {
+        free (out);
+        return NULL;
+    }
+    return out;
+}
+
+
+
+static int round_trip (boxes_t *ctx, const char *s)
+/*
+ *  Draw a box around s and remove it again.
+ *
+ *  RETURNS:  true if the result equals s
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    char *boxed = run (ctx, 'd', s);
+    char *plain = NULL;
+    int   ok;
+
+    if (boxed)
+        plain = run (ctx, 'r', boxed);
+    ok = plain != NULL && strcmp (plain, s) == 0;
+    free (boxed);
+    free (plain);
+    return ok;
+}
+
+
+
+static void test_round_trip()
+{
+    boxes_t *ctx = boxes_new();
+    int      ok;
+
+    ok = ctx != NULL && boxes_load_config (ctx, CONFIG_FILE) == BOXES_OK
+        && round_trip (ctx, text)
+        && boxes_set_design (ctx, "c") == BOXES_OK
+        && boxes_set_option (ctx, 'p', "a1") == BOXES_OK
+        && round_trip (ctx, text);
+    report ("draw/remove round trip", ok);
+    boxes_free (ctx);
+}
+
+
+
+static void test_too_small()
+{
+    boxes_t *ctx = boxes_new();
+    char     out[64];
+    size_t   len = 4;
+    int      ok;
+
+    ok = ctx != NULL
+        && boxes_load_config_buffer (ctx, tiny_config, strlen (tiny_config)) == BOXES_OK
+        && boxes_draw (ctx, tiny_text, strlen (tiny_text), out, &len) == BOXES_TOOSMALL
+        && len == strlen (tiny_box) + 1;
+    if (ok) {
+        ok = boxes_draw (ctx, tiny_text, strlen (tiny_text), out, &len) == BOXES_OK
+            && len == strlen (tiny_box) && strcmp (out, tiny_box) == 0;
+    }
+    report ("BOXES_TOOSMALL reports needed size", ok);
+    boxes_free (ctx);
+}
+
+
+
+static void test_config_buffer()
+{
+    boxes_t *ctx = boxes_new();
+    char    *res = NULL;
+    int      ok;
+
+    ok = ctx != NULL
+        && boxes_load_config_buffer (ctx, tiny_config, strlen (tiny_config)) == BOXES_OK
+        && boxes_set_design (ctx, "tiny") == BOXES_OK
+        && boxes_set_design (ctx, "dog") == BOXES_ERROR
+        && (res = run (ctx, 'd', tiny_text)) != NULL
+        && strcmp (res, tiny_box) == 0
+        && boxes_load_config_buffer (ctx, "BOX broken\n", 11) == BOXES_ERROR
+        && round_trip (ctx, text);           /* old designs still loaded */
+    report ("boxes_load_config_buffer", ok);
+    free (res);
+    boxes_free (ctx);
+}
+
+
+
+#ifdef HAVE_PTHREAD
+
+typedef struct {
+    boxes_t    *ctx;
+    const char *expected;                /* box drawn around text */
+    int         ok;
+} job_t;
+
+static void *worker (void *arg)
+{
+    job_t *job = (job_t *) arg;
+    int    i;
+
+    job->ok = 1;
+    for (i=0; i<ROUNDS && job->ok; ++i) {
+        char *boxed = run (job->ctx, 'd', text);
+        job->ok = boxed != NULL && strcmp (boxed, job->expected) == 0
+            && round_trip (job->ctx, text);
+        free (boxed);
+    }
+    return NULL;
+}
+
+
+
+static void test_threads()
+/*
+ *  Use two contexts with different designs and options in two threads at
+ *  the same time. Each must produce the same boxes as it does alone.
+ *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+{
+    job_t     job[2];
+    pthread_t thread[2];
+    int       ok = 1;
+    int       i;
+
+    memset (job, 0, sizeof(job));
+    for (i=0; i<2; ++i) {
+        job[i].ctx = boxes_new();
+        if (job[i].ctx == NULL)
+            ok = 0;
+    }
+    ok = ok && boxes_load_config (job[0].ctx, CONFIG_FILE) == BOXES_OK
+        && boxes_set_design (job[0].ctx, "shell") == BOXES_OK
+        && boxes_load_config_buffer (job[1].ctx, tiny_config, strlen (tiny_config)) == BOXES_OK
+        && boxes_set_option (job[1].ctx, 'p', "h2") == BOXES_OK
+        && (job[0].expected = run (job[0].ctx, 'd', text)) != NULL
+        && (job[1].expected = run (job[1].ctx, 'd', text)) != NULL
+        && strcmp (job[0].expected, job[1].expected) != 0;
+
+    if (ok) {
+        for (i=0; i<2; ++i) {
+            if (pthread_create (thread + i, NULL, worker, job + i))
+                job[i].ctx = NULL;
+        }
+        for (i=0; i<2; ++i) {
+            if (job[i].ctx == NULL)
+                ok = 0;
+            else
+                pthread_join (thread[i], NULL);
+            ok = ok && job[i].ok;
+        }
+    }
+    report ("two contexts in concurrent threads", ok);
+
+    for (i=0; i<2; ++i) {
+        free ((char *) job[i].expected);
+        boxes_free (job[i].ctx);
+    }
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+
+int main()
+{
+    printf ("Testing the boxes library ...\n");
+    test_round_trip();
+    test_too_small();
+    test_config_buffer();
+    #ifdef HAVE_PTHREAD
+        test_threads();
+    #endif
+    printf ("Library tests: %d failed.\n", failed);
+    return failed;
+}
+
+/*EOF*/                                                  /* vim: set sw=4: */
@@ -0,0 +1,152 @@
+#!/usr/bin/env bash
+#
+# Tests of the boxes server mode (-w) and of BOXES_SERVER.
+#
+# File:             server_test.sh
+# Date created:     October 19, 2026 (Monday, 15:55h)
+# Author:           agent <agent@local>
+# _____________________________________________________________________
+#
+# Starts a server on a temporary socket and a copy of the config file,
+# and checks that boxes run with BOXES_SERVER prints the same as boxes
+# run on its own, for drawing (-d), removing (-r), and mending (-m) boxes.
+# The expected output is computed first. Then the config file is made
+# invalid, which the server ignores, so that the clients can only succeed
+# by way of the server.
+#
+# Clients which keep their connection open without sending requests must
+# not hold up the others. This is tested with more idle connections than
+# server threads, if perl is available to open them.
+#
+# On Linux, the server reads the config file again when it changes. This
+# is tested by adding a design to the config file, then making it invalid
+# again, and using the new design.
+#
+# Usage: server_test.sh
+
+if [ ${PWD##*/} != "test" ]; then
+    >&2 echo "Please run this script from the test folder."
+    exit 2
+fi
+if [ ! -x ../src/boxes ]; then
+    >&2 echo "Please build boxes first."
+    exit 2
+fi
+
+declare -r tmp=$(mktemp -d)
+declare -r sock=$tmp/boxes.sock
+declare -r cfg=$tmp/config
+declare -i server=0
+declare -i idle=0
+declare -i failed=0
+trap '[ $idle -ne 0 ] && kill $idle 2>/dev/null;
+    [ $server -ne 0 ] && kill $server 2>/dev/null; rm -rf $tmp' EXIT
+
+unset BOXES_SERVER BOXES_SHM BOXES_CACHE
+export BOXES=$cfg
+cp ../boxes-config $cfg
+
+function check() {
+    local name=$1
+    shift
+    if "$@"; then
+        echo "    $name OK"
+    else
+        echo "    $name FAILED"
+        failed=$failed+1
+    fi
+}
+
+function wait_for() {
+    local -i i
+    for ((i = 0; i < 50; ++i)); do
+        "$@" && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+function fails() {
+    ! "$@" > /dev/null 2>&1
+}
+
+function break_config() {
+    # the server keeps its designs when the config file becomes invalid
+    echo "not a config file" > $cfg
+    sleep 0.5
+}
+
+printf 'Hello, world!\n  second line\n\nlast\n' > $tmp/text
+../src/boxes -d dog $tmp/text > $tmp/dog
+../src/boxes -d c -p a1 $tmp/text > $tmp/c
+sed -e '2s/\*\//* /' $tmp/c > $tmp/c.broken
+../src/boxes -d simple $tmp/text > $tmp/simple
+
+declare -a cases=(
+    "-d dog"        text
+    "-d c -a c -p h2" text
+    "-r"            dog
+    "-r -d c"       c
+    "-m"            dog
+    "-m -d c"       c.broken
+    "-m -s 40x6"    simple
+)
+declare -i n=${#cases[@]}
+declare -i i
+for ((i = 0; i < n; i += 2)); do
+    ../src/boxes ${cases[i]} $tmp/${cases[i+1]} > $tmp/expected.$i
+done
+
+echo "Testing the server mode ..."
+../src/boxes -j 2 -w $sock 2> $tmp/server.log &
+server=$!
+check "server started" wait_for test -S $sock
+
+break_config
+check "config file invalid" fails ../src/boxes -d dog $tmp/text
+
+export BOXES_SERVER=$sock
+for ((i = 0; i < n; i += 2)); do
+    ../src/boxes ${cases[i]} $tmp/${cases[i+1]} > $tmp/actual.$i
+    check "boxes ${cases[i]}" cmp -s $tmp/expected.$i $tmp/actual.$i
+done
+
+if command -v perl > /dev/null; then
+    perl -MIO::Socket::UNIX -e '@c = map { IO::Socket::UNIX->new (Peer => $ARGV[0])
+        or die } 1..8; sleep 30' $sock &
+    idle=$!
+    sleep 0.5
+    timeout 5 ../src/boxes ${cases[0]} $tmp/${cases[1]} > $tmp/actual.idle
+    check "idle connections" cmp -s $tmp/expected.0 $tmp/actual.idle
+    kill $idle
+    wait $idle 2>/dev/null
+    idle=0
+fi
+
+if [ "$(uname)" = "Linux" ]; then
+    cp ../boxes-config $cfg
+    cat >> $cfg <<EOF
+
+BOX srvtest
+sample
+    [x]
+ends
+shapes { w ("[") e ("]") }
+elastic (w, e)
+END srvtest
+EOF
+    sleep 1
+    break_config
+    ../src/boxes -d srvtest $tmp/text > $tmp/actual.reload
+    check "config file read again" grep -q '^\[Hello, world!\]$' $tmp/actual.reload
+fi
+
+kill $server
+wait $server 2>/dev/null
+server=0
+check "socket removed" test ! -e $sock
+
+echo "Server tests: $failed failed."
+exit $failed
+
+#EOF
@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+#
+# Tests of the designs shared in memory (BOXES_SHM).
+#
+# File:             shm_test.sh
+# Date created:     October 19, 2026 (Monday, 16:05h)
+# Author:           agent <agent@local>
+# _____________________________________________________________________
+#
+# Publishes the designs of a copy of the config file in shared memory,
+# then changes the file in place, keeping its size, inode, and the second
+# of its modification time. The next process must notice the change and
+# use the new designs, not those in the stale segment.
+#
+# Usage: shm_test.sh
+
+if [ ${PWD##*/} != "test" ]; then
+    >&2 echo "Please run this script from the test folder."
+    exit 2
+fi
+if [ ! -x ../src/boxes ]; then
+    >&2 echo "Please build boxes first."
+    exit 2
+fi
+if [ ! -d /dev/shm ]; then
+    echo "No /dev/shm, shared memory tests skipped."
+    exit 0
+fi
+
+declare -r tmp=$(mktemp -d)
+declare -r cfg=$tmp/config
+declare -i failed=0
+ls /dev/shm > $tmp/segments.before
+trap 'comm -13 $tmp/segments.before <(ls /dev/shm) | sed -e "s|^|/dev/shm/|" \
+    | grep "/boxes-" | xargs rm -f; rm -rf $tmp' EXIT
+
+unset BOXES_SERVER BOXES_CACHE
+export BOXES=$cfg
+export BOXES_SHM=1
+
+function check() {
+    local name=$1
+    shift
+    if "$@"; then
+        echo "    $name OK"
+    else
+        echo "    $name FAILED"
+        failed=$failed+1
+    fi
+}
+
+function runs() {
+    "$@" > /dev/null 2>&1
+}
+
+function fails() {
+    ! runs "$@"
+}
+
+function new_segment() {
+    comm -13 $tmp/segments.before <(ls /dev/shm) | grep -q "^boxes-"
+}
+
+echo "Testing designs in shared memory ..."
+echo "Hello, world!" > $tmp/text
+cp ../boxes-config $cfg
+touch -d @1700000000.100000000 $cfg
+runs ../src/boxes -d dog $tmp/text
+check "segment published" new_segment
+check "segment attached" runs ../src/boxes -d dog $tmp/text
+
+sed -e 's/^\(BOX\|END\) dog$/\1 dgo/' ../boxes-config > $tmp/renamed
+cat $tmp/renamed > $cfg
+touch -d @1700000000.200000000 $cfg
+check "new design used" runs ../src/boxes -d dgo $tmp/text
+check "old design gone" fails ../src/boxes -d dog $tmp/text
+
+echo "Shared memory tests: $failed failed."
+exit $failed
+
+#EOF